@@ -1,13 +1,10 @@
-#include <vector>
 #include "types.h"
 #include "helpers.h"
 #include "attacks.h"
 
-Bitboard lineBB[64][64];
-Bitboard bishopMagicCache[64][512];
-Bitboard rookMagicCache[64][4096];
+static constexpr std::array<std::array<Bitboard, 64>, 64> genLineBB(){
+    std::array<std::array<Bitboard, 64>, 64> lines = {};
 
-void initLineBB(){
     for (Square sq = 0; sq < 64; sq++){
         for (int8 di : {-1, 0, 1}){
             for (int8 dj : {-1, 0, 1}){
@@ -16,71 +13,96 @@ void initLineBB(){
                 }
                 Rank i = getRank(sq);
                 File j = getFile(sq);
-                Bitboard pathMask = 0; 
+                Bitboard pathMask = 0;
 
                 for (; isInGrid(i, j); i += di, j += dj){
                     int8 curSq = posToSquare(i, j);
                     pathMask |= (1ULL << curSq);
-                    lineBB[sq][curSq] = pathMask; 
+                    lines[sq][curSq] = pathMask;
                 }
             }
         }
     }
+    return lines;
 }
 
-static void initSingleMagic(Square sq, bool isBishop){
-    // Generate all non-end-of-path positions for blockers
-    uint64 maskAllPos = isBishop ? BISHOP_MAGIC_MASK[sq] : ROOK_MAGIC_MASK[sq]; 
-    std::vector<Square> pos; 
+// Rays going out of every square (exclusive of the square itself). Rays 0 to 3 are for rooks and 4 to 7
+// are for bishops. For each piece, the first two rays go towards higher squares and the last two go lower
+static constexpr int8 RAY_DI[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+static constexpr int8 RAY_DJ[8] = {1, 0, -1, 0, 1, -1, 1, -1};
 
-    for (Bitboard m = maskAllPos; m;){
-        pos.push_back(poplsb(m));
-    }
-
-    // Init variables
-    std::vector<uint64> blocker((1 << pos.size()), 0);
-    std::vector<Bitboard> attack((1 << pos.size()), 0);
+struct RayTable{
+    Bitboard rays[8][64];
+};
 
-    // Generate all blocker masks and their corresponding attack masks
-    for (uint64 blkMask = 0; blkMask < static_cast<uint64>(1 << pos.size()); blkMask++){
-        for (uint64 m = blkMask; m;){
-            blocker[blkMask] |= (1ULL << pos[poplsb(m)]);
-        }
-        for (int8 di : {-1, 0, 1}){
-            for (int8 dj : {-1, 0, 1}){
-                if ((!di and !dj)
-                    or (isBishop and abs(di) != abs(dj))
-                    or (!isBishop and abs(di) == abs(dj)))
-                {
-                    continue;
-                }
-                Rank i = getRank(sq);
-                File j = getFile(sq);
+static constexpr RayTable genRays(){
+    RayTable table = {};
 
-                for (i += di, j += dj; isInGrid(i, j); i += di, j += dj){
-                    Square curSq = posToSquare(i, j);
-                    attack[blkMask] |= (1ULL << curSq);
+    for (int dir = 0; dir < 8; dir++){
+        for (Square sq = 0; sq < 64; sq++){
+            Rank i = getRank(sq) + RAY_DI[dir];
+            File j = getFile(sq) + RAY_DJ[dir];
 
-                    // We stop if we hit blocker but our mask is still inclusive of it
-                    if (blocker[blkMask] & (1ULL << curSq)){
-                        break; 
-                    }
-                }
+            for (; isInGrid(i, j); i += RAY_DI[dir], j += RAY_DJ[dir]){
+                table.rays[dir][sq] |= (1ULL << posToSquare(i, j));
             }
         }
     }
-    uint64 magic = isBishop ? BISHOP_MAGIC[sq] : ROOK_MAGIC[sq];
-    Bitboard *cache = isBishop ? bishopMagicCache[sq] : rookMagicCache[sq];
+    return table;
+}
+
+static constexpr RayTable RAYS = genRays();
 
-    for (uint64 blkMask = 0; blkMask < static_cast<uint64>(1 << pos.size()); blkMask++){
-        uint64 hashIdx = (blocker[blkMask] * magic) >> (64 - pos.size());
-        cache[hashIdx] = attack[blkMask];
+static constexpr Bitboard genSliderAttack(Square sq, Bitboard blockers, bool isBishop){
+    Bitboard attack = 0;
+
+    for (int dir = 4 * isBishop; dir < 4 * isBishop + 4; dir++){
+        // Cut the ray off after the first blocker (but our mask is still inclusive of it)
+        Bitboard ray = RAYS.rays[dir][sq];
+        Bitboard hit = ray & blockers;
+
+        if (hit){
+            ray ^= RAYS.rays[dir][(dir & 3) < 2 ? lsb(hit) : msb(hit)];
+        }
+        attack |= ray;
     }
+    return attack;
 }
 
-void initMagicCache(){
+static constexpr void genSingleMagic(SliderAttackTable &table, Square sq, bool isBishop){
+    // Blockers can be on any non-end-of-path square
+    Bitboard maskAllPos = isBishop ? BISHOP_MAGIC_MASK[sq] : ROOK_MAGIC_MASK[sq];
+    Bitboard *cache = table.attacks + (isBishop ? SLIDER_OFFSETS.bishop[sq] : SLIDER_OFFSETS.rook[sq]);
+
+    // Enumerate all subsets of the mask in increasing order (Carry-Rippler) and store their attacks. The
+    // k-th subset in increasing order has PEXT index k since PEXT keeps the relative order of the bits
+    Bitboard blocker = 0;
+    uint64 subsetIdx = 0;
+
+    do{
+#ifdef USE_PEXT
+        cache[subsetIdx] = genSliderAttack(sq, blocker, isBishop);
+#else
+        uint64 magic = isBishop ? BISHOP_MAGIC[sq] : ROOK_MAGIC[sq];
+        int8 shift = isBishop ? BISHOP_MAGIC_SHIFT[sq] : ROOK_MAGIC_SHIFT[sq];
+
+        cache[(blocker * magic) >> (64 - shift)] = genSliderAttack(sq, blocker, isBishop);
+#endif
+        blocker = (blocker - maskAllPos) & maskAllPos;
+        subsetIdx++;
+    } while (blocker);
+}
+
+static constexpr SliderAttackTable genSliderAttackTable(){
+    SliderAttackTable table = {};
+
     for (Square sq = 0; sq < 64; sq++){
-        initSingleMagic(sq, true);
-        initSingleMagic(sq, false);
+        genSingleMagic(table, sq, true);
+        genSingleMagic(table, sq, false);
     }
-}
\ No newline at end of file
+    return table;
+}
+
+// Both tables are built by the compiler and end up in a read-only section so there is no startup cost
+constexpr std::array<std::array<Bitboard, 64>, 64> lineBB = genLineBB();
+constexpr SliderAttackTable sliderAttackTable = genSliderAttackTable();
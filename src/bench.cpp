@@ -0,0 +1,245 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include "bench.h"
+#include "board.h"
+#include "search.h"
+#include "tt.h"
+#include "uci.h"
+#include "timecontrol.h"
+
+static const std::string BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
+    "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
+    "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
+    "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
+    "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
+    "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
+    "r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R1BQ1RK1 b - - 2 10",
+    "3r3k/2r4p/1p1b3q/p4P2/P2Pp3/1B2P3/3BQ1RP/6K1 w - - 3 87",
+    "2r4r/1p4k1/1Pnp4/3Qb1pq/8/4BpPp/5P2/2RR1BK1 w - - 0 42",
+    "4q1bk/6b1/7p/p1p4p/PNPpP2P/KN4P1/3Q4/4R3 b - - 0 37",
+    "2q3r1/1r2pk2/pp3pp1/2pP3p/P1Pb1BbP/1P4Q1/R3NPP1/4R1K1 w - - 2 34",
+    "1r2r2k/1b4q1/pp5p/2pPp1p1/P3Pn2/1P1B1Q1P/2R3P1/4BR1K b - - 1 37",
+    "8/6pk/2b1Rp2/3r4/1R1B2PP/P5K1/8/2r5 b - - 16 42",
+    "1r4k1/4ppb1/2n1b1qp/pB4p1/1n1BP1P1/7P/2PNQPK1/3RN3 w - - 8 29",
+    "3r4/ppq1ppkp/4bnp1/2pN4/2P1P3/1P4P1/PQ3PBP/R4K2 b - - 2 20",
+    "1r5k/2pq2p1/3p3p/p1pP4/4QP2/PP1R3P/6PK/8 w - - 1 51",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/8/3k4/8/2K5/2P5/8 w - - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3"
+};
+
+uint64 startupTime = 0;
+
+static const int SMP_BENCH_THREADS[] = {1, 2, 4, 8, 16, 64};
+
+struct TimemanBenchClock{
+    TimePoint base;
+    TimePoint incr;
+};
+
+// Base time and increment in milliseconds (the first one is the 1+0.01 bullet control)
+static const TimemanBenchClock TIMEMAN_BENCH_CLOCKS[] = {{1000, 10}, {5000, 50}, {10000, 100}};
+
+struct PerftEntry{
+    std::string fen;
+    Depth depth;
+    uint64 nodes;
+};
+
+static const PerftEntry PERFT_BENCH_POSITIONS[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609ULL},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603ULL},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083ULL},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292ULL},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487ULL},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594ULL}
+};
+
+static uint64 perft(Position &board, Depth depth){
+    moveList moves;
+    board.genAllMoves(false, moves);
+
+    // Bulk counting at the last ply
+    if (depth <= 1){
+        return moves.sz;
+    }
+
+    uint64 nodes = 0;
+
+    for (int i = 0; i < moves.sz; i++){
+        board.makeMove(moves.moves[i].move);
+        nodes += perft(board, depth - 1);
+        board.undoLastMove();
+    }
+    return nodes;
+}
+
+static void benchPosition(std::string fen, Depth depth, uint64 &nodes, TimePoint &time){
+    // Every position is searched from a clean state so that results are reproducible
+    Position board;
+    uciSearchLims lims = {};
+
+    board.readFen(fen);
+    lims.depthLim = depth;
+
+    globalEngine.tt.clearTT();
+    globalEngine.clearHistory();
+
+    // Deep entries of earlier positions would change the node counts at high depths
+    if (globalEngine.persistentSize){
+        globalEngine.persistentTT.clearTT();
+    }
+
+    TimePoint startTime = getTime();
+    globalEngine.search(board, lims);
+
+    time += getTime() - startTime;
+    nodes += globalEngine.totalNodes();
+}
+
+void runBench(Depth depth){
+    int originalThreadCount = globalEngine.getThreadCount();
+    uint64 nodes = 0;
+    TimePoint time = 0;
+
+    globalEngine.setThreadCount(1);
+
+#ifdef USE_STATS
+    globalEngine.threadSD[0].stats = {};
+#endif
+
+    for (std::string fen : BENCH_FENS){
+        benchPosition(fen, depth, nodes, time);
+    }
+
+#ifdef USE_STATS
+    printSearchStats(globalEngine.threadSD[0].stats);
+#endif
+
+    globalEngine.setThreadCount(originalThreadCount);
+    globalEngine.tt.clearTT();
+    
+    std::cout << nodes << " nodes " << static_cast<uint64>(nodes * 1000000.0 / (time + 1)) << " nps" << std::endl;
+}
+
+void runSMPBench(Depth depth){
+    const int runs = sizeof(SMP_BENCH_THREADS) / sizeof(SMP_BENCH_THREADS[0]);
+    int originalThreadCount = globalEngine.getThreadCount();
+    uint64 nodes[runs] = {};
+    TimePoint time[runs] = {};
+
+    for (int i = 0; i < runs; i++){
+        globalEngine.setThreadCount(SMP_BENCH_THREADS[i]);
+
+        for (std::string fen : BENCH_FENS){
+            benchPosition(fen, depth, nodes[i], time[i]);
+        }
+    }
+    globalEngine.setThreadCount(originalThreadCount);
+    globalEngine.tt.clearTT();
+
+    // Print the summary after all searches so it isn't mixed with search output.
+    // Everything is relative to the single threaded run
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "threads | time-to-depth (ms) | speedup | nodes | node duplication" << std::endl;
+
+    for (int i = 0; i < runs; i++){
+        std::cout << SMP_BENCH_THREADS[i] << " | " 
+                  << time[i] / 1000 << " | " 
+                  << static_cast<double>(time[0]) / std::max(time[i], static_cast<TimePoint>(1)) << " | " 
+                  << nodes[i] << " | " 
+                  << static_cast<double>(nodes[i]) / std::max(nodes[0], static_cast<uint64>(1)) << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+void runPerftBench(){
+    uint64 nodes = 0;
+    TimePoint startTime = getTime();
+    bool allMatch = true;
+
+    for (const PerftEntry &entry : PERFT_BENCH_POSITIONS){
+        Position board;
+        board.readFen(entry.fen);
+
+        uint64 result = perft(board, entry.depth);
+        nodes += result;
+
+        if (result != entry.nodes){
+            allMatch = false;
+            std::cout << "perft mismatch: " << entry.fen << " depth " << static_cast<int>(entry.depth) 
+                      << " expected " << entry.nodes << " got " << result << std::endl;
+        }
+    }
+    TimePoint time = getTime() - startTime;
+    
+    std::cout << (allMatch ? "perft ok " : "perft failed ") << nodes << " nodes " 
+              << static_cast<uint64>(nodes * 1000000.0 / (time + 1)) << " nps" << std::endl;
+}
+
+void runTimemanBench(){
+    int originalThreadCount = globalEngine.getThreadCount();
+    globalEngine.setThreadCount(1);
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (const TimemanBenchClock &clock : TIMEMAN_BENCH_CLOCKS){
+        // Replay the bench positions as consecutive moves of a game for the side to move. Every search
+        // gets the clock that is left after the previous ones (in microseconds, UCI times are in ms)
+        TimePoint clockLeft = clock.base * 1000;
+        TimePoint minClock = clockLeft;
+        TimePoint totalUsed = 0, totalOptimal = 0, worstOverrun = 0;
+        int overruns = 0;
+        bool flagged = false;
+
+        globalEngine.tt.clearTT();
+        globalEngine.clearHistory();
+
+        for (std::string fen : BENCH_FENS){
+            Position board;
+            uciSearchLims lims = {};
+
+            board.readFen(fen);
+            lims.timeLeft[board.getTurn()] = clockLeft / 1000;
+            lims.timeIncr[board.getTurn()] = clock.incr;
+
+            // Time that the time manager allots for this move
+            timeMan allotted;
+            allotted.init(board.getTurn(), lims);
+
+            TimePoint startTime = getTime();
+            globalEngine.search(board, lims);
+            TimePoint used = getTime() - startTime;
+
+            totalUsed += used;
+            totalOptimal += allotted.optimalTime;
+
+            if (used > allotted.maximumTime){
+                overruns++;
+                worstOverrun = std::max(worstOverrun, used - allotted.maximumTime);
+            }
+
+            clockLeft -= used;
+            flagged |= (clockLeft <= 0);
+            minClock = std::min(minClock, clockLeft);
+            clockLeft += clock.incr * 1000;
+        }
+        
+        // Print the summary for each clock after its searches so it isn't mixed with search output
+        std::cout << "timeman " << clock.base << "+" << clock.incr 
+                  << " | used (ms) " << totalUsed / 1000.0 
+                  << " | allotted (ms) " << totalOptimal / 1000.0 
+                  << " | used/allotted " << static_cast<double>(totalUsed) / std::max(totalOptimal, static_cast<TimePoint>(1))
+                  << " | hard limit overruns " << overruns << " (worst " << worstOverrun / 1000.0 << " ms)"
+                  << " | min clock (ms) " << minClock / 1000.0 
+                  << " | " << (flagged ? "flagged" : "ok") << std::endl;
+    }
+    std::cout << std::defaultfloat;
+
+    globalEngine.setThreadCount(originalThreadCount);
+    globalEngine.tt.clearTT();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "types.h"
+
+const Depth BENCH_DEPTH = 12;
+const Depth SMP_BENCH_DEPTH = 14;
+
+// Time in microseconds that main spent initializing before it could answer commands ("bench startup")
+extern uint64 startupTime;
+
+// Single threaded fixed depth search over a set of positions (used to check node counts and nps)
+void runBench(Depth depth);
+
+// Fixed depth search with an increasing number of threads. Reports time-to-depth and node
+// duplication (total nodes relative to the single threaded search) for each thread count
+void runSMPBench(Depth depth);
+
+// Perft over a fixed set of positions with known node counts. Used to check that move generation
+// gives identical results across build variants (such as PEXT=yes) and to compare their speed
+void runPerftBench();
+
+// Replays the bench positions as games under a few time controls (including 1+0.01) and reports time
+// used against time allotted, hard limit overruns, and whether the clock ran out
+void runTimemanBench();
@@ -1,11 +1,17 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include "types.h"
 #include "helpers.h"
 #include "movepick.h"
 #include "nnue.h"
 #include "attacks.h"
+#include "packed.h"
+
+// Size of the position stack (the stack is reset on irreversible moves so this only needs to hold a
+// fifty move rule's worth of game moves on top of the search)
+const int POSITION_STACK_SIZE = MAX_PLY + 105;
 
 struct BoardState{
     Piece moveCaptType;
@@ -16,8 +22,18 @@ struct BoardState{
     TTKey zhash;
     
     int halfMoveClock;
+    int pliesFromNull;
     int moveCount;
 
+    // Check info (computed once per position in calcCheckInfo). Checkers are the pieces giving check to
+    // the side to move. blockers[col] are the pieces (of either color) that are the only piece between
+    // col's king and an enemy slider and pinners[col] are col's sliders that pin an enemy piece to the
+    // enemy king. checkSquares[piece] are the squares where the side to move's piece would give check
+    Bitboard checkers;
+    Bitboard blockers[2];
+    Bitboard pinners[2];
+    Bitboard checkSquares[7];
+
     NeuralNetwork nnue;
 };
 
@@ -26,9 +42,11 @@ class Position{
 public:
     // Move gen (fully legal)
     void genAllMoves(bool noisy, moveList &moves);
+    void genQuietChecks(moveList &moves);
 
     // Legality related for staged movegen
     bool isLegal(Move move);
+    bool givesCheck(Move move);
 
     // Move make/unmake
     void makeMove(Move move);
@@ -39,8 +57,10 @@ public:
     // Eval related
     bool seeGreater(Move move, Score value);
     bool drawByRepetition(Depth searchPly);
+    bool upcomingRepetition(Depth searchPly);
     bool drawByInsufficientMaterial();
     bool drawByFiftyMoveRule();
+    bool hasRepeated();
     Score eval();
 
     // Fen and debug related
@@ -48,6 +68,10 @@ public:
     std::string getFen();
     void resetStack();
 
+    // Packed training data (see packed.h)
+    PackedPosition pack(Score whiteScore, uint8 result);
+    bool unpack(const PackedPosition &packed);
+
     // Interface and utility access
     inline Color getTurn(){
         return turn;
@@ -58,32 +82,37 @@ public:
     inline Bitboard allPiece(Piece piece){
         return pieceBB[piece][BLACK] | pieceBB[piece][WHITE];
     }
+    inline Bitboard pieceBitboard(Piece pieceType, Color col){
+        return pieceBB[pieceType][col];
+    }
+    inline Bitboard allPieces(){
+        return allBB;
+    }
     inline Square kingSq(Color col){
         return lsb(pieceBB[KING][col]);
     }
     inline TTKey getHash(){
         return pos[stk].zhash;
     }
-    inline Bitboard allAttack(Color col, Bitboard occupancy){
-        Bitboard attacked = 0;
-        attacked |= pawnsAllAttack(pieceBB[PAWN][col], col) | kingAttack(kingSq(col));
-
-        for (Bitboard m = pieceBB[KNIGHT][col]; m;){
-            attacked |= knightAttack(poplsb(m));
-        }
-        for (Bitboard m = pieceBB[BISHOP][col]; m;){
-            attacked |= bishopAttack(poplsb(m), occupancy);
-        }
-        for (Bitboard m = pieceBB[ROOK][col]; m;){
-            attacked |= rookAttack(poplsb(m), occupancy);
-        }
-        for (Bitboard m = pieceBB[QUEEN][col]; m;){
-            attacked |= queenAttack(poplsb(m), occupancy);
-        }
-        return attacked;
+    inline int8 getCastleRights(){
+        return pos[stk].castleRights;
+    }
+    inline File getEpFile(){
+        return pos[stk].epFile;
+    }
+    inline int getHalfMoveClock(){
+        return pos[stk].halfMoveClock;
+    }
+    inline Bitboard attackersTo(Square sq, Bitboard occupancy){
+        return (pawnAttack(sq, WHITE) & pieceBB[PAWN][BLACK])
+             | (pawnAttack(sq, BLACK) & pieceBB[PAWN][WHITE])
+             | (knightAttack(sq) & allPiece(KNIGHT))
+             | (bishopAttack(sq, occupancy) & (allPiece(BISHOP) | allPiece(QUEEN)))
+             | (rookAttack(sq, occupancy) & (allPiece(ROOK) | allPiece(QUEEN)))
+             | (kingAttack(sq) & allPiece(KING));
     }
     inline bool inCheck(){
-        return (allAttack(!turn, allBB) & pieceBB[KING][turn]);
+        return pos[stk].checkers;
     }
     inline Piece movePieceEnc(Move move){
         return board[moveFrom(move)];
@@ -112,6 +141,10 @@ private:
     std::vector<BoardState> pos;
     int stk;
 
+    // Dense copy of the hashes on the stack for repetition checks (so that we don't have to touch the
+    // board states, each of which holds an accumulator)
+    std::array<TTKey, POSITION_STACK_SIZE> keyHistory;
+
     // Board variables
     Piece board[64];
     Bitboard pieceBB[7][2];
@@ -119,7 +152,12 @@ private:
     Bitboard allBB;
     Color turn;
 
+    // Position setup helpers (shared by readFen and unpack)
+    void clearPosition();
+    void finishSetup();
+
     // Move gen helpers
+    void calcCheckInfo();
     void calcPins(Bitboard &pinHV, Bitboard &pinDA);
     void calcAttacks(Bitboard &attacked, Bitboard &okSq);
 
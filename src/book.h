@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include "types.h"
+#include "board.h"
+
+// Polyglot opening books (.bin). The book is memory mapped and the entries of a position are found
+// with a binary search on its Polyglot key (Polyglot has its own Zobrist keys so we can't use zhash)
+
+// Every entry is 16 bytes (big endian): key (8), move (2), weight (2), and learn (4)
+const int BOOK_ENTRY_SIZE = 16;
+
+// Open a book (an empty path closes the current book). Returns false if the file can't be used
+bool openBook(std::string path);
+
+// Polyglot key of the position
+TTKey polyglotKey(Position &board);
+
+// Pick one of the position's book moves at random (weighted by the entry weights). Returns
+// NULL_OR_NO_MOVE if there is no book, the position isn't in the book, or the move is illegal
+Move probeBook(Position &board);
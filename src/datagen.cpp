@@ -0,0 +1,260 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <memory>
+#include "datagen.h"
+#include "board.h"
+#include "search.h"
+#include "tt.h"
+#include "uci.h"
+#include "packed.h"
+
+struct DatagenConfig{
+    int games = DATAGEN_GAMES;
+    int threads = 1;
+    uint64 nodes = DATAGEN_NODES;
+    int randomPlies = DATAGEN_RANDOM_PLIES;
+    int hash = DATAGEN_HASH;
+    std::string outFile = "datagen.txt";
+    bool packed = false;
+};
+
+// Shared between workers
+static std::atomic<int> gamesStarted;
+static std::atomic<int> gamesFinished;
+static std::atomic<uint64> positionsWritten;
+static std::mutex outMutex;
+
+static bool playRandomOpening(Position &board, int randomPlies, std::mt19937_64 &rng){
+    board.readFen(startPosFen);
+
+    for (int i = 0; i < randomPlies; i++){
+        moveList moves;
+        board.genAllMoves(false, moves);
+
+        if (moves.sz == 0){
+            return false;
+        }
+        Move move = moves.moves[rng() % moves.sz].move;
+        bool fmr = board.moveCaptType(move) != NO_PIECE or board.movePieceType(move) == PAWN;
+
+        board.makeMove(move);
+
+        if (fmr){
+            board.resetStack();
+        }
+    }
+    moveList moves;
+    board.genAllMoves(false, moves);
+
+    return moves.sz > 0;
+}
+
+static void playGame(const DatagenConfig &config, SearchData &sd, std::mt19937_64 &rng, std::vector<PackedPosition> &records, std::vector<std::string> &fens, uint8 &result){
+    Position board;
+    records.clear();
+    fens.clear();
+
+    // Step 1) Random opening (redo it if the game is already over or very one sided)
+    while (true){
+        if (!playRandomOpening(board, config.randomPlies, rng)){
+            continue;
+        }
+        sd.tt->clearTT();
+        sd.clearHistory();
+        independentSearch(board, sd, config.nodes, 0, 0);
+
+        if (sd.result.depthSearched > 0 and abs(sd.result.lines[0].score) <= DATAGEN_OPENING_MAX_SCORE){
+            break;
+        }
+    }
+
+    int winPlies = 0;
+    int drawPlies = 0;
+
+    for (int ply = 0; ; ply++){
+        // Step 2) Game over by the rules. Checkmate is a loss for the side to move
+        moveList moves;
+        board.genAllMoves(false, moves);
+
+        if (moves.sz == 0){
+            result = board.inCheck() ? (board.getTurn() == WHITE ? PACKED_BLACK_WIN : PACKED_WHITE_WIN) : PACKED_DRAW;
+            return;
+        }
+        if (board.drawByRepetition(0) or board.drawByInsufficientMaterial() or board.drawByFiftyMoveRule() or ply >= DATAGEN_MAX_PLIES){
+            result = PACKED_DRAW;
+            return;
+        }
+
+        // Step 3) Search (give up on the game if not even one iteration finished)
+        independentSearch(board, sd, config.nodes, 0, 0);
+
+        if (sd.result.depthSearched == 0){
+            records.clear();
+            fens.clear();
+            result = PACKED_DRAW;
+            return;
+        }
+
+        Score score = sd.result.lines[0].score;
+        Move move = sd.result.lines[0].pvMoves[0];
+        Score whiteScore = board.getTurn() == WHITE ? score : -score;
+
+        // Step 4) Adjudication
+        winPlies = abs(score) >= ADJUDICATE_WIN_SCORE ? winPlies + 1 : 0;
+        drawPlies = (abs(score) <= ADJUDICATE_DRAW_SCORE and ply >= ADJUDICATE_DRAW_MIN_PLY) ? drawPlies + 1 : 0;
+
+        if (winPlies >= ADJUDICATE_WIN_PLIES){
+            result = whiteScore > 0 ? PACKED_WHITE_WIN : PACKED_BLACK_WIN;
+            return;
+        }
+        if (drawPlies >= ADJUDICATE_DRAW_PLIES){
+            result = PACKED_DRAW;
+            return;
+        }
+
+        // Step 5) Only keep quiet positions (not in check and the best move is quiet) with non-mate scores
+        bool noisy = board.moveCaptType(move) != NO_PIECE or movePromo(move);
+
+        // (the result is filled in once the game is over and FENs are only needed for text output)
+        if (!board.inCheck() and !noisy and abs(score) < FOUND_TB_WIN){
+            records.push_back(board.pack(whiteScore, PACKED_DRAW));
+
+            if (!config.packed){
+                fens.push_back(board.getFen());
+            }
+        }
+
+        // Step 6) Play the move
+        bool fmr = board.moveCaptType(move) != NO_PIECE or board.movePieceType(move) == PAWN;
+        board.makeMove(move);
+
+        if (fmr){
+            board.resetStack();
+        }
+    }
+}
+
+static void datagenWorker(const DatagenConfig &config, int workerId){
+    // Everything the search touches is private to this worker
+    std::unique_ptr<SearchData> sd = std::make_unique<SearchData>();
+    std::unique_ptr<ttStruct> tt = std::make_unique<ttStruct>();
+
+    tt->setSize(config.hash);
+    sd->tt = tt.get();
+    sd->clearHistory();
+
+    std::mt19937_64 rng(std::random_device{}() ^ (0x9E3779B97F4A7C15ULL * (workerId + 1)));
+    std::vector<PackedPosition> records;
+    std::vector<std::string> fens;
+    std::string buffer;
+
+    while (gamesStarted.fetch_add(1) < config.games){
+        uint8 result = PACKED_DRAW;
+        playGame(config, *sd, rng, records, fens, result);
+
+        for (PackedPosition &record : records){
+            record.result = result;
+        }
+
+        // Score and result are from white's view
+        buffer.clear();
+
+        if (config.packed){
+            buffer.assign(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(PackedPosition));
+        }
+        else{
+            for (size_t i = 0; i < records.size(); i++){
+                buffer += fens[i] + " | " + std::to_string(records[i].score) + " | ";
+                buffer += (result == PACKED_WHITE_WIN ? "1.0" : result == PACKED_BLACK_WIN ? "0.0" : "0.5");
+                buffer += "\n";
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(outMutex);
+            std::ofstream out(config.outFile, std::ios::app | std::ios::binary);
+            out << buffer;
+        }
+        positionsWritten += records.size();
+        gamesFinished++;
+    }
+}
+
+static void printDatagenProgress(const DatagenConfig &config, TimePoint time){
+    double seconds = time / 1000000.0;
+    double positionsPerSecond = positionsWritten / (seconds + 1e-9);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "datagen games " << gamesFinished << "/" << config.games
+              << " positions " << positionsWritten
+              << " time " << seconds << " s"
+              << " pos/s " << positionsPerSecond
+              << " pos/s/thread " << positionsPerSecond / config.threads << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+void runDatagenCommand(std::istringstream &iss){
+    DatagenConfig config;
+    std::string token;
+
+    while (iss >> token){
+        if (token == "games"){
+            iss >> config.games;
+        }
+        else if (token == "threads"){
+            iss >> config.threads;
+        }
+        else if (token == "nodes"){
+            iss >> config.nodes;
+        }
+        else if (token == "random"){
+            iss >> config.randomPlies;
+        }
+        else if (token == "hash"){
+            iss >> config.hash;
+        }
+        else if (token == "out"){
+            iss >> config.outFile;
+        }
+        else if (token == "format"){
+            iss >> token;
+            config.packed = (token == "packed");
+        }
+    }
+    config.threads = std::max(config.threads, 1);
+
+    gamesStarted = 0;
+    gamesFinished = 0;
+    positionsWritten = 0;
+
+    std::cout << "datagen " << config.games << " games with " << config.threads << " threads at " << config.nodes
+              << " nodes per move appending to " << config.outFile << std::endl;
+
+    TimePoint startTime = getTime();
+    TimePoint lastReport = startTime;
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < config.threads; i++){
+        workers.emplace_back(datagenWorker, std::cref(config), i);
+    }
+
+    // Report progress while the workers play
+    while (gamesFinished < config.games){
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        if (getTime() - lastReport >= DATAGEN_REPORT_INTERVAL * 1000000LL){
+            lastReport = getTime();
+            printDatagenProgress(config, lastReport - startTime);
+        }
+    }
+    for (std::thread &worker : workers){
+        worker.join();
+    }
+    printDatagenProgress(config, getTime() - startTime);
+}
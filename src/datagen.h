@@ -0,0 +1,29 @@
+#pragma once
+
+#include <sstream>
+#include "types.h"
+
+// Self-play games (random opening plies and then fixed node searches)
+const int DATAGEN_GAMES = 100;
+const uint64 DATAGEN_NODES = 5000;
+const int DATAGEN_RANDOM_PLIES = 8;
+const int DATAGEN_HASH = 8;                      // Private TT size (MB) of every worker
+const Score DATAGEN_OPENING_MAX_SCORE = 1000;    // Openings that are already lost are thrown away
+
+// Adjudication
+const Score ADJUDICATE_WIN_SCORE = 2500;
+const int ADJUDICATE_WIN_PLIES = 4;
+const Score ADJUDICATE_DRAW_SCORE = 10;
+const int ADJUDICATE_DRAW_PLIES = 10;
+const int ADJUDICATE_DRAW_MIN_PLY = 80;
+const int DATAGEN_MAX_PLIES = 500;
+
+// How often (in seconds) progress is reported
+const int DATAGEN_REPORT_INTERVAL = 10;
+
+// Command: datagen [games N] [threads N] [nodes N] [random N] [hash MB] [out file] [format text | packed]
+// Every worker thread plays its own games with its own Position, SearchData, and TT. Positions are
+// written as "fen | score | result" where score (cp) and result (1.0, 0.5, 0.0) are from white's view
+// or as 32 byte PackedPosition records (see packed.h). Positions are appended to the output file so several
+// runs can write to the same file. Games where a search doesn't finish an iteration are thrown away
+void runDatagenCommand(std::istringstream &iss);
@@ -0,0 +1,398 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include "epd.h"
+#include "board.h"
+#include "search.h"
+#include "tt.h"
+#include "uci.h"
+
+struct EpdPosition{
+    std::string fen;
+    std::string id;
+    std::vector<Move> bestMoves;
+    std::vector<Move> avoidMoves;
+};
+
+struct EpdResult{
+    bool solved = false;
+    Move move = NULL_OR_NO_MOVE;
+    Depth depth = 0;
+    uint64 nodes = 0;
+    TimePoint time = 0;
+
+    // Depth, nodes, and time when the best move became correct for good (only if solved)
+    Depth solveDepth = 0;
+    uint64 solveNodes = 0;
+    TimePoint solveTime = 0;
+};
+
+struct EpdConfig{
+    TimePoint movetime = EPD_MOVETIME;
+    uint64 nodes = 0;
+    Depth depth = 0;
+    int jobs = 1;
+    int hash = EPD_HASH;
+};
+
+// Shared between workers
+static std::atomic<int> positionsStarted;
+static std::atomic<int> positionsFinished;
+static std::mutex printMutex;
+
+std::string moveToSAN(Position &board, Move move){
+    Square st = moveFrom(move);
+    Square en = moveTo(move);
+    Piece type = board.movePieceType(move);
+    std::string san;
+
+    // Castling is a king move of 2 files
+    if (type == KING and abs(getFile(st) - getFile(en)) == 2){
+        return getFile(en) > getFile(st) ? "O-O" : "O-O-O";
+    }
+
+    std::string target = char(getFile(en) + 'a') + std::to_string(getRank(en) + 1);
+    bool capture = board.moveCaptType(move) != NO_PIECE;
+
+    if (type == PAWN){
+        if (capture){
+            san += char(getFile(st) + 'a');
+            san += 'x';
+        }
+        san += target;
+
+        if (movePromo(move)){
+            san += '=';
+            san += pieceToChar((movePromo(move) << 1) + WHITE);
+        }
+        return san;
+    }
+
+    san += pieceToChar((type << 1) + WHITE);
+
+    // Disambiguate by file, then rank, then both if another piece of the same type can go to the same square
+    moveList moves;
+    board.genAllMoves(false, moves);
+    bool ambiguous = false, sameFile = false, sameRank = false;
+
+    for (int i = 0; i < moves.sz; i++){
+        Move other = moves.moves[i].move;
+
+        if (other != move and moveTo(other) == en and board.movePieceType(other) == type){
+            ambiguous = true;
+            sameFile |= getFile(moveFrom(other)) == getFile(st);
+            sameRank |= getRank(moveFrom(other)) == getRank(st);
+        }
+    }
+    if (ambiguous){
+        if (!sameFile){
+            san += char(getFile(st) + 'a');
+        }
+        else if (!sameRank){
+            san += std::to_string(getRank(st) + 1);
+        }
+        else{
+            san += char(getFile(st) + 'a') + std::to_string(getRank(st) + 1);
+        }
+    }
+    if (capture){
+        san += 'x';
+    }
+    return san + target;
+}
+
+Move sanToMove(Position &board, std::string san){
+    // Drop annotations and markers that moveToSAN doesn't write
+    std::string clean;
+
+    for (char c : san){
+        if (c == '0'){
+            clean += 'O';
+        }
+        else if (c != '+' and c != '#' and c != '!' and c != '?' and c != '='){
+            clean += c;
+        }
+    }
+
+    moveList moves;
+    board.genAllMoves(false, moves);
+
+    for (int i = 0; i < moves.sz; i++){
+        Move move = moves.moves[i].move;
+        std::string candidate = moveToSAN(board, move);
+        candidate.erase(std::remove(candidate.begin(), candidate.end(), '='), candidate.end());
+
+        if (candidate == clean){
+            return move;
+        }
+    }
+    return NULL_OR_NO_MOVE;
+}
+
+static bool parseEpdLine(Position &board, const std::string &line, EpdPosition &epd){
+    // Step 1) The first four fields are the position (blank and '#' comment lines are skipped quietly)
+    std::istringstream iss(line);
+    std::string field, error;
+    int fields = 0;
+
+    epd.fen.clear();
+
+    for (; fields < 4 and iss >> field; fields++){
+        epd.fen += field + " ";
+    }
+    if (fields == 0 or epd.fen[0] == '#'){
+        return false;
+    }
+    epd.fen += "0 1";
+
+    if (fields < 4 or !checkFen(epd.fen, error)){
+        std::cout << "epd: skipped " << line << " (" << (fields < 4 ? "not a position" : error) << ")" << std::endl;
+        return false;
+    }
+    board.readFen(epd.fen);
+
+    // Step 2) Operations are seperated by ';' (which may appear inside quoted strings)
+    std::string rest, operation;
+    std::getline(iss, rest);
+    std::vector<std::string> operations;
+    bool quoted = false;
+
+    for (char c : rest){
+        if (c == '"'){
+            quoted = !quoted;
+        }
+        if (c == ';' and !quoted){
+            operations.push_back(operation);
+            operation.clear();
+        }
+        else{
+            operation += c;
+        }
+    }
+    operations.push_back(operation);
+
+    // Step 3) Keep bm, am, and id
+    for (const std::string &op : operations){
+        std::istringstream opStream(op);
+        std::string opcode, operand;
+        opStream >> opcode;
+
+        if (opcode == "bm" or opcode == "am"){
+            while (opStream >> operand){
+                Move move = sanToMove(board, operand);
+
+                if (move == NULL_OR_NO_MOVE){
+                    std::lock_guard<std::mutex> lock(printMutex);
+                    std::cout << "epd: illegal or unknown move " << operand << " in " << epd.fen << std::endl;
+                    continue;
+                }
+                (opcode == "bm" ? epd.bestMoves : epd.avoidMoves).push_back(move);
+            }
+        }
+        else if (opcode == "id"){
+            size_t start = op.find('"');
+            size_t end = op.rfind('"');
+            std::getline(opStream >> std::ws, operand);
+            epd.id = (start != std::string::npos and end > start) ? op.substr(start + 1, end - start - 1) : operand;
+        }
+    }
+    return !epd.bestMoves.empty() or !epd.avoidMoves.empty();
+}
+
+static bool isCorrect(const EpdPosition &epd, Move move){
+    if (!epd.bestMoves.empty() and std::find(epd.bestMoves.begin(), epd.bestMoves.end(), move) == epd.bestMoves.end()){
+        return false;
+    }
+    return std::find(epd.avoidMoves.begin(), epd.avoidMoves.end(), move) == epd.avoidMoves.end();
+}
+
+static void solvePosition(const EpdConfig &config, const EpdPosition &epd, SearchData &sd, EpdResult &result){
+    Position board;
+    board.readFen(epd.fen);
+
+    // Every position starts from scratch so results don't depend on the order of the suite
+    sd.tt->clearTT();
+    sd.clearHistory();
+    independentSearch(board, sd, config.nodes, config.depth, config.nodes or config.depth ? 0 : config.movetime * 1000);
+
+    if (sd.iterations.empty()){
+        return;
+    }
+    IterationInfo &last = sd.iterations.back();
+    result.move = last.move;
+    result.depth = last.depth;
+    result.nodes = sd.nodes;
+    result.time = getTime() - sd.independentStartTime;
+
+    // Walk back from the last iteration to the first one of the final run of correct best moves
+    int first = sd.iterations.size();
+
+    while (first > 0 and isCorrect(epd, sd.iterations[first - 1].move)){
+        first--;
+    }
+    if (first < static_cast<int>(sd.iterations.size())){
+        result.solved = true;
+        result.solveDepth = sd.iterations[first].depth;
+        result.solveNodes = sd.iterations[first].nodes;
+        result.solveTime = sd.iterations[first].time;
+    }
+}
+
+static void epdWorker(const EpdConfig &config, const std::vector<EpdPosition> &suite, std::vector<EpdResult> &results){
+    // Everything the search touches is private to this worker
+    std::unique_ptr<SearchData> sd = std::make_unique<SearchData>();
+    std::unique_ptr<ttStruct> tt = std::make_unique<ttStruct>();
+
+    tt->setSize(config.hash);
+    sd->tt = tt.get();
+
+    int total = suite.size();
+    int idx;
+
+    while ((idx = positionsStarted.fetch_add(1)) < total){
+        const EpdPosition &epd = suite[idx];
+        EpdResult &result = results[idx];
+        solvePosition(config, epd, *sd, result);
+
+        Position board;
+        board.readFen(epd.fen);
+
+        std::lock_guard<std::mutex> lock(printMutex);
+        int finished = ++positionsFinished;
+
+        std::cout << "epd " << finished << "/" << total << " " << (epd.id.empty() ? "#" + std::to_string(idx + 1) : epd.id)
+                  << (result.solved ? " solved" : " failed")
+                  << " move " << (result.move ? moveToSAN(board, result.move) : "none");
+
+        for (Move move : epd.bestMoves){
+            std::cout << (move == epd.bestMoves[0] ? " bm " : " ") << moveToSAN(board, move);
+        }
+        for (Move move : epd.avoidMoves){
+            std::cout << (move == epd.avoidMoves[0] ? " am " : " ") << moveToSAN(board, move);
+        }
+        std::cout << " depth " << int(result.depth);
+
+        if (result.solved){
+            std::cout << " solve depth " << int(result.solveDepth)
+                      << " solve time " << result.solveTime / 1000 << " ms"
+                      << " solve nodes " << result.solveNodes;
+        }
+        std::cout << std::endl;
+    }
+}
+
+void runEpdCommand(std::istringstream &iss){
+    EpdConfig config;
+    config.jobs = globalEngine.getThreadCount();
+
+    std::string inFile, token;
+    iss >> inFile;
+
+    while (iss >> token){
+        if (token == "movetime"){
+            iss >> config.movetime;
+        }
+        else if (token == "nodes"){
+            iss >> config.nodes;
+        }
+        else if (token == "depth"){
+            int depth;
+            iss >> depth;
+            config.depth = std::clamp(depth, 1, MAX_PLY - 1);
+        }
+        else if (token == "jobs"){
+            iss >> config.jobs;
+        }
+        else if (token == "hash"){
+            iss >> config.hash;
+        }
+    }
+
+    std::ifstream in(inFile);
+
+    if (inFile.empty() or !in){
+        std::cout << "usage: epd <file> [movetime ms | nodes N | depth N] [jobs N] [hash MB]" << std::endl;
+        return;
+    }
+
+    // Step 1) Read the suite (positions without a bm or am can't be checked)
+    std::vector<EpdPosition> suite;
+    std::string line;
+    Position board;
+
+    while (std::getline(in, line)){
+        EpdPosition epd;
+
+        if (parseEpdLine(board, line, epd)){
+            suite.push_back(epd);
+        }
+    }
+    if (suite.empty()){
+        std::cout << "epd: no positions with bm or am in " << inFile << std::endl;
+        return;
+    }
+    config.jobs = std::clamp(config.jobs, 1, static_cast<int>(suite.size()));
+
+    std::cout << "epd " << suite.size() << " positions from " << inFile << " with " << config.jobs << " jobs at ";
+
+    if (config.nodes){
+        std::cout << config.nodes << " nodes";
+    }
+    else if (config.depth){
+        std::cout << int(config.depth) << " depth";
+    }
+    else{
+        std::cout << config.movetime << " ms";
+    }
+    std::cout << " per position" << std::endl;
+
+    // Step 2) Solve
+    std::vector<EpdResult> results(suite.size());
+    std::vector<std::thread> workers;
+    TimePoint startTime = getTime();
+
+    positionsStarted = 0;
+    positionsFinished = 0;
+
+    for (int i = 0; i < config.jobs; i++){
+        workers.emplace_back(epdWorker, std::cref(config), std::cref(suite), std::ref(results));
+    }
+    for (std::thread &worker : workers){
+        worker.join();
+    }
+    TimePoint totalTime = getTime() - startTime;
+
+    // Step 3) Summary (time and nodes to solution are over the solved positions)
+    int solved = 0;
+    TimePoint solveTime = 0;
+    uint64 solveNodes = 0;
+    uint64 nodes = 0;
+
+    for (const EpdResult &result : results){
+        nodes += result.nodes;
+
+        if (result.solved){
+            solved++;
+            solveTime += result.solveTime;
+            solveNodes += result.solveNodes;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "epd solved " << solved << "/" << suite.size() << " (" << 100.0 * solved / suite.size() << "%)" << std::endl;
+
+    if (solved){
+        std::cout << "epd time to solution total " << solveTime / 1000 << " ms average " << solveTime / 1000.0 / solved << " ms" << std::endl;
+        std::cout << "epd nodes to solution total " << solveNodes << " average " << solveNodes / solved << std::endl;
+    }
+    std::cout << "epd total time " << totalTime / 1000 << " ms nodes " << nodes
+              << " nps " << static_cast<uint64>(nodes * 1000000.0 / (totalTime + 1)) << std::endl;
+    std::cout << std::defaultfloat;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include "types.h"
+
+class Position;
+
+// Default limits of every position of a test suite
+const TimePoint EPD_MOVETIME = 1000;     // ms
+const int EPD_HASH = 16;                 // Private TT size (MB) of every worker
+
+// Standard algebraic notation of a legal move without check or mate markers (ex: "Nbd7", "exd6", "e8=Q", "O-O")
+std::string moveToSAN(Position &board, Move move);
+
+// Parse a SAN move ("+", "#", "!", "?", and "=" are optional and "0-0" is accepted). Returns NULL_OR_NO_MOVE if
+// the move is not legal in the position
+Move sanToMove(Position &board, std::string san);
+
+// Command: epd <file> [movetime ms | nodes N | depth N] [jobs N] [hash MB]
+// Searches every position of an EPD test suite and checks the best move against its "bm" (one of them must
+// be played) and "am" (none of them may be played) opcodes. Positions are solved by single threaded
+// independent searches with their own TTs, with up to jobs positions (by default the UCI thread count) at
+// the same time. A position is solved once the best move is correct and stays correct until the end of the
+// search, and the time and nodes at that point are reported as the time and nodes to solution. Blank and '#'
+// comment lines are ignored and lines without a valid position are reported and skipped
+void runEpdCommand(std::istringstream &iss);
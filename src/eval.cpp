@@ -1,6 +1,8 @@
+#include <algorithm>
 #include "board.h"
 #include "types.h"
 #include "helpers.h"
+#include "tt.h"
 
 bool Position::drawByRepetition(Depth searchPly){
     // True if one of the following (sensitive to en passant square and castle rights) is true
@@ -19,7 +21,7 @@ bool Position::drawByRepetition(Depth searchPly){
         curPos -= 2;
 
         // Repetition check
-        if (pos[stk].zhash == pos[curPos].zhash){
+        if (keyHistory[stk] == keyHistory[curPos]){
             if (i <= searchPly or ++counter == 2){
                 return true;
             }
@@ -28,6 +30,65 @@ bool Position::drawByRepetition(Depth searchPly){
     return false;
 }
 
+bool Position::upcomingRepetition(Depth searchPly){
+    // True if the side to move has a reversible move that leads to a position in the current search
+    // (so the position is at least a draw). A reversible move changes the hash by the two piece keys and
+    // the turn key so we can look it up in the cuckoo table by the difference of the hashes. Based
+    // on Marcel van Kervinck's cycle detection (as used in Stockfish)
+
+    int end = std::min({pos[stk].halfMoveClock, pos[stk].pliesFromNull, stk});
+
+    if (end < 3){
+        return false;
+    }
+
+    // 'other' is the hash difference caused by the other side's moves since position stk - i. If it's 0
+    // then the other side's pieces are back where they were and only one move of ours is the difference
+    TTKey originalKey = keyHistory[stk];
+    TTKey other = originalKey ^ keyHistory[stk - 1] ^ ttRngTurn;
+
+    for (int i = 3; i <= end; i += 2){
+        other ^= keyHistory[stk - i + 1] ^ keyHistory[stk - i] ^ ttRngTurn;
+
+        if (other){
+            continue;
+        }
+        TTKey moveKey = originalKey ^ keyHistory[stk - i];
+        int idx = cuckooHash1(moveKey);
+
+        if (cuckooTable.keys[idx] != moveKey){
+            idx = cuckooHash2(moveKey);
+        }
+        if (cuckooTable.keys[idx] != moveKey){
+            continue;
+        }
+
+        // The move must not be blocked. We only trust the cycle if the repeated position is in the search
+        Move move = cuckooTable.moves[idx];
+        Square st = moveFrom(move);
+        Square en = moveTo(move);
+
+        if (!(getLine(st, en) & allBB & ~((1ULL << st) | (1ULL << en))) and i < searchPly){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Position::hasRepeated(){
+    // True if any position since the last irreversible move (that is still on our stack)
+    // occured earlier in the game
+    
+    for (int curPos = stk; curPos >= 4 and stk - curPos <= pos[stk].halfMoveClock; curPos--){
+        for (int prevPos = curPos - 4; prevPos >= 0 and curPos - prevPos <= pos[curPos].halfMoveClock; prevPos -= 2){
+            if (keyHistory[curPos] == keyHistory[prevPos]){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 bool Position::drawByFiftyMoveRule(){
     // Note that checkmate has a higher priority. Very hard to deal with especially when
     // it comes to TT so we often just ignore it
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cctype>
+#include "evalbatch.h"
+#include "board.h"
+#include "uci.h"
+#include "search.h"
+
+static bool isClock(const std::string &field){
+    return !field.empty() and std::all_of(field.begin(), field.end(), ::isdigit);
+}
+
+static void evalSlice(const std::vector<std::string> &lines, std::vector<std::string> &results, int start, int end){
+    // Every thread has its own board (readFen refreshes the accumulator from scratch)
+    Position board;
+
+    for (int i = start; i < end; i++){
+        // Keep the FEN fields as they are written (the clocks are only FEN fields if they are numbers)
+        std::istringstream iss(lines[i]);
+        std::string field, fen;
+        int fields = 0;
+
+        while (fields < 6 and iss >> field and field != "|" and (fields < 4 or isClock(field))){
+            fen += (fields++ ? " " : "") + field;
+        }
+
+        // Blank lines stay blank and lines that aren't a position are marked so that the lines still match
+        std::string error;
+
+        if (fields == 0){
+            results[i] = "\n";
+            continue;
+        }
+        if (fields < 4 or !checkFen(fen, error)){
+            results[i] = fen + " | error\n";
+            continue;
+        }
+        board.readFen(fen + (fields == 4 ? " 0 1" : fields == 5 ? " 1" : ""));
+
+        Score eval = board.eval();
+        results[i] = fen + " | " + std::to_string(board.getTurn() == WHITE ? eval : -eval) + "\n";
+    }
+}
+
+void runEvalBatchCommand(std::istringstream &iss){
+    std::string inFile, outFile, token;
+    int threads = globalEngine.getThreadCount();
+
+    iss >> inFile >> outFile;
+
+    while (iss >> token){
+        if (token == "threads"){
+            iss >> threads;
+        }
+    }
+    threads = std::max(threads, 1);
+
+    std::ifstream in(inFile);
+    std::ofstream out(outFile);
+
+    if (inFile.empty() or outFile.empty() or !in or !out){
+        std::cout << "usage: evalbatch <infile> <outfile> [threads N]" << std::endl;
+        return;
+    }
+
+    std::vector<std::string> lines;
+    std::vector<std::string> results(EVALBATCH_CHUNK_SIZE);
+    uint64 positions = 0;
+    TimePoint startTime = getTime();
+
+    lines.reserve(EVALBATCH_CHUNK_SIZE);
+
+    while (true){
+        // Step 1) Read a chunk
+        lines.clear();
+        std::string line;
+
+        while (static_cast<int>(lines.size()) < EVALBATCH_CHUNK_SIZE and std::getline(in, line)){
+            lines.push_back(line);
+        }
+        if (lines.empty()){
+            break;
+        }
+
+        // Step 2) Split it evenly between the threads
+        int count = lines.size();
+        std::vector<std::thread> workers;
+
+        for (int t = 0; t < threads; t++){
+            int start = static_cast<int64>(count) * t / threads;
+            int end = static_cast<int64>(count) * (t + 1) / threads;
+            workers.emplace_back(evalSlice, std::cref(lines), std::ref(results), start, end);
+        }
+        for (std::thread &worker : workers){
+            worker.join();
+        }
+
+        // Step 3) Write the results in order (one line for every line read)
+        for (int i = 0; i < count; i++){
+            out << results[i];
+            positions++;
+        }
+    }
+    TimePoint time = getTime() - startTime;
+
+    std::cout << "evalbatch " << positions << " positions in " << time / 1000 << " ms with " << threads << " threads ("
+              << static_cast<uint64>(positions * 1000000.0 / (time + 1)) << " positions/s)" << std::endl;
+}
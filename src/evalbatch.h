@@ -0,0 +1,15 @@
+#pragma once
+
+#include <sstream>
+#include "types.h"
+
+// Number of positions read, evaluated, and written at a time
+const int EVALBATCH_CHUNK_SIZE = 65536;
+
+// Command: evalbatch <infile> <outfile> [threads N]
+// Static NNUE eval (no search) of every position in a FEN or EPD file (one position per line, anything after
+// the FEN such as EPD opcodes or datagen's "| score | result" is ignored). Writes one "fen | eval" line for
+// every line read where eval is in centipawns from white's view and the fen is written as it was read.
+// Blank lines stay blank and lines without a legal FEN give "fen | error". Uses the UCI thread count unless
+// a thread count is given
+void runEvalBatchCommand(std::istringstream &iss);
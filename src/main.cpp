@@ -2,18 +2,59 @@
 #include "uci.h"
 #include "attacks.h"
 #include "search.h"
+#include "bench.h"
+#include "datagen.h"
+#include "packed.h"
+#include "evalbatch.h"
+#include "epd.h"
+#include "server.h"
+
+int main(int argc, char *argv[]){
+    // Attack tables and hash keys are generated at compile time so only the rest needs an init
+    TimePoint startTime = getTime();
 
-int main(){
-    initLineBB();
-    initMagicCache();
     initNNUEWeights();
     initLMR();
-    initTT();
 
     // Default settings
-    globalTT.setSize(16);
-    setThreadCount(1);
+    globalEngine.tt.setSize(16);
+    globalEngine.setThreadCount(1);
+    globalEngine.setPersistentSize(0);
+
+    startupTime = getTime() - startTime;
     
+    // Run the benchmark, test suite, analysis server, or training data tools from the command line (ex: "./Superultra-2.1 bench 13")
+    std::string mode = argc >= 2 ? argv[1] : "";
+
+    if (mode == "bench" or mode == "datagen" or mode == "convert" or mode == "evalbatch" or mode == "epd" or mode == "server"){
+        std::string args;
+        
+        for (int i = 2; i < argc; i++){
+            args += std::string(argv[i]) + " ";
+        }
+        std::istringstream iss(args);
+
+        if (mode == "bench"){
+            runBenchCommand(iss);
+        }
+        else if (mode == "datagen"){
+            runDatagenCommand(iss);
+        }
+        else if (mode == "convert"){
+            runConvertCommand(iss);
+        }
+        else if (mode == "evalbatch"){
+            runEvalBatchCommand(iss);
+        }
+        else if (mode == "epd"){
+            runEpdCommand(iss);
+        }
+        else{
+            runServerCommand(iss);
+        }
+        return 0;
+    }
+
     // Begin the UCI loop
     doLoop();
 }
\ No newline at end of file
@@ -2,101 +2,91 @@
 #include "movepick.h"
 #include "attacks.h"
 
-void Position::calcPins(Bitboard &pinHV, Bitboard &pinDA){
-    // Diagonal
-    Bitboard maskDA = ((pieceBB[BISHOP][!turn] | pieceBB[QUEEN][!turn]) & bishopAttack(kingSq(turn), colorBB[!turn]));
-    
-    while (maskDA){
-        Square sq = poplsb(maskDA);
+void Position::calcCheckInfo(){
+    // Checkers
+    pos[stk].checkers = attackersTo(kingSq(turn), allBB) & colorBB[!turn];
 
-        // Path to king (exclusive of both endpoints) 
-        Bitboard toKing = getLine(sq, kingSq(turn)) ^ pieceBB[KING][turn] ^ (1ULL << sq); 
+    // Blockers and pinners. Snipers are the enemy sliders that would attack the king on an empty board
+    for (Color col : {WHITE, BLACK}){
+        Square king = kingSq(col);
+        Bitboard snipers = ((pieceBB[BISHOP][!col] | pieceBB[QUEEN][!col]) & bishopAttack(king, 0))
+                         | ((pieceBB[ROOK][!col] | pieceBB[QUEEN][!col]) & rookAttack(king, 0));
 
-        // Check if they pin us
-        if (countOnes(toKing & colorBB[turn]) == 1){
-            pinDA |= toKing | (1ULL << sq); 
-        }
-    }
+        pos[stk].blockers[col] = 0;
+        pos[stk].pinners[!col] = 0;
 
-    // Horizontal
-    Bitboard maskHV = ((pieceBB[ROOK][!turn] | pieceBB[QUEEN][!turn]) & rookAttack(kingSq(turn), colorBB[!turn]));
+        while (snipers){
+            Square sq = poplsb(snipers);
 
-    while (maskHV){
-        Square sq = poplsb(maskHV);
+            // Pieces on the path to king (exclusive of both endpoints)
+            Bitboard between = (getLine(sq, king) ^ (1ULL << sq) ^ (1ULL << king)) & allBB;
 
-        // Path to king (exclusive of both endpoints) 
-        Bitboard toKing = getLine(sq, kingSq(turn)) ^ pieceBB[KING][turn] ^ (1ULL << sq); 
+            if (countOnes(between) == 1){
+                pos[stk].blockers[col] |= between;
 
-        // Check if they pin us
-        if (countOnes(toKing & colorBB[turn]) == 1){
-            pinHV |= toKing | (1ULL << sq); 
+                if (between & colorBB[col]){
+                    pos[stk].pinners[!col] |= (1ULL << sq);
+                }
+            }
         }
     }
-}
 
-void Position::calcAttacks(Bitboard &attacked, Bitboard &okSq){
-    // Pawns
-    Bitboard pawnAtt = pawnsAllAttack(pieceBB[PAWN][!turn], !turn);
-    attacked |= pawnAtt;
-    
-    if (pawnAtt & pieceBB[KING][turn]){
-        okSq &= (pieceBB[PAWN][!turn] & pawnAttack(kingSq(turn), turn));
-    }
+    // Check squares
+    Square enemyKing = kingSq(!turn);
 
-    // King
-    Bitboard kingAtt = kingAttack(lsb(pieceBB[KING][!turn]));
-    attacked |= kingAtt;
+    pos[stk].checkSquares[NO_PIECE] = 0;
+    pos[stk].checkSquares[PAWN] = pawnAttack(enemyKing, !turn);
+    pos[stk].checkSquares[KNIGHT] = knightAttack(enemyKing);
+    pos[stk].checkSquares[BISHOP] = bishopAttack(enemyKing, allBB);
+    pos[stk].checkSquares[ROOK] = rookAttack(enemyKing, allBB);
+    pos[stk].checkSquares[QUEEN] = pos[stk].checkSquares[BISHOP] | pos[stk].checkSquares[ROOK];
+    pos[stk].checkSquares[KING] = 0;
+}
 
-    // Knights
-    for (Bitboard m = pieceBB[KNIGHT][!turn]; m;){
+void Position::calcPins(Bitboard &pinHV, Bitboard &pinDA){
+    // Enemy sliders that pin one of our pieces were found in calcCheckInfo
+    Square king = kingSq(turn);
+
+    for (Bitboard m = pos[stk].pinners[!turn]; m;){
         Square sq = poplsb(m);
 
-        Bitboard att = knightAttack(sq);
-        attacked |= att;
+        // Path to king (inclusive of the pinner)
+        Bitboard toKing = getLine(sq, king) ^ pieceBB[KING][turn];
 
-        // They hit our king
-        if (att & pieceBB[KING][turn]){
-            okSq &= (1ULL << sq);
+        if (getRank(sq) == getRank(king) or getFile(sq) == getFile(king)){
+            pinHV |= toKing;
         }
-    }
-
-    // Bishops
-    for (Bitboard m = pieceBB[BISHOP][!turn]; m;){
-        Square sq = poplsb(m);
-
-        Bitboard att = bishopAttack(sq, allBB ^ pieceBB[KING][turn]);
-        attacked |= att;
-        
-        // They hit our king
-        if (att & pieceBB[KING][turn]){
-            okSq &= getLine(sq, kingSq(turn));
+        else{
+            pinDA |= toKing;
         }
     }
+}
 
-    // Rooks
-    for (Bitboard m = pieceBB[ROOK][!turn]; m;){
-        Square sq = poplsb(m);
-
-        Bitboard att = rookAttack(sq, allBB ^ pieceBB[KING][turn]);
-        attacked |= att;
+void Position::calcAttacks(Bitboard &attacked, Bitboard &okSq){
+    // Squares that must be reached to get out of check (found in calcCheckInfo)
+    Bitboard checkers = pos[stk].checkers;
 
-        // They hit our king
-        if (att & pieceBB[KING][turn]){
-            okSq &= getLine(sq, kingSq(turn));
-        }
+    if (countOnes(checkers) >= 2){
+        okSq = 0;
+    }
+    else if (checkers){
+        okSq &= getLine(lsb(checkers), kingSq(turn)) | checkers;
     }
 
-    // Queens
-    for (Bitboard m = pieceBB[QUEEN][!turn]; m;){
-        Square sq = poplsb(m);
+    // Enemy attacks (sliders see through our king so that it can't step back along the attack)
+    Bitboard occupancy = allBB ^ pieceBB[KING][turn];
 
-        Bitboard att = queenAttack(sq, allBB ^ pieceBB[KING][turn]);
-        attacked |= att;
+    attacked |= pawnsAllAttack(pieceBB[PAWN][!turn], !turn);
+    attacked |= kingAttack(kingSq(!turn));
 
-        // They hit our king
-        if (att & pieceBB[KING][turn]){
-            okSq &= getLine(sq, kingSq(turn));
-        }
+    for (Bitboard m = pieceBB[KNIGHT][!turn]; m;){
+        attacked |= knightAttack(poplsb(m));
+    }
+    for (Bitboard m = pieceBB[BISHOP][!turn] | pieceBB[QUEEN][!turn]; m;){
+        attacked |= bishopAttack(poplsb(m), occupancy);
+    }
+    for (Bitboard m = pieceBB[ROOK][!turn] | pieceBB[QUEEN][!turn]; m;){
+        attacked |= rookAttack(poplsb(m), occupancy);
     }
 }
 
@@ -336,4 +326,149 @@ void Position::genAllMoves(bool noisy, moveList &moves){
     genRookMoves(noisy, pinHV, pinDA, okSq, moves);
     genQueenMoves(noisy, pinHV, pinDA, okSq, moves);
     genKingMoves(noisy, attacked, moves);
-}
\ No newline at end of file
+}
+
+void Position::genQuietChecks(moveList &moves){
+    // Quiet moves that give check (only used when not in check). We only look at destinations that give
+    // direct check unless the piece blocks one of our sliders from the enemy king (a discovered check)
+    // and we filter the candidates with isLegal and givesCheck
+    Bitboard thirdRank = ALL_IN_RANK[turn == WHITE ? 2 : 5];
+    Bitboard lastRank = ALL_IN_RANK[turn == WHITE ? 7 : 0];
+    Bitboard discoverers = pos[stk].blockers[!turn] & colorBB[turn];
+
+    auto addIfCheck = [&](Square st, Bitboard targets){
+        while (targets){
+            Move move = encodeMove(st, poplsb(targets), NO_PIECE);
+
+            if (isLegal(move) and givesCheck(move)){
+                moves.addMove(move);
+            }
+        }
+    };
+
+    // Pawn pushes (promotions are noisy so skip them)
+    for (Bitboard m = pieceBB[PAWN][turn]; m;){
+        Square st = poplsb(m);
+        Bitboard push = pawnsUp(1ULL << st, turn) & (~allBB);
+        Bitboard targets = (push | (pawnsUp(push & thirdRank, turn) & (~allBB))) & (~lastRank);
+
+        addIfCheck(st, (discoverers & (1ULL << st)) ? targets : targets & pos[stk].checkSquares[PAWN]);
+    }
+
+    // Knights and sliders
+    for (Bitboard m = pieceBB[KNIGHT][turn]; m;){
+        Square st = poplsb(m);
+        Bitboard targets = knightAttack(st) & (~allBB);
+
+        addIfCheck(st, (discoverers & (1ULL << st)) ? targets : targets & pos[stk].checkSquares[KNIGHT]);
+    }
+    for (Bitboard m = pieceBB[BISHOP][turn]; m;){
+        Square st = poplsb(m);
+        Bitboard targets = bishopAttack(st, allBB) & (~allBB);
+
+        addIfCheck(st, (discoverers & (1ULL << st)) ? targets : targets & pos[stk].checkSquares[BISHOP]);
+    }
+    for (Bitboard m = pieceBB[ROOK][turn]; m;){
+        Square st = poplsb(m);
+        Bitboard targets = rookAttack(st, allBB) & (~allBB);
+
+        addIfCheck(st, (discoverers & (1ULL << st)) ? targets : targets & pos[stk].checkSquares[ROOK]);
+    }
+    for (Bitboard m = pieceBB[QUEEN][turn]; m;){
+        Square st = poplsb(m);
+        Bitboard targets = queenAttack(st, allBB) & (~allBB);
+
+        addIfCheck(st, (discoverers & (1ULL << st)) ? targets : targets & pos[stk].checkSquares[QUEEN]);
+    }
+
+    // King (only discovered checks and we skip castling)
+    if (discoverers & pieceBB[KING][turn]){
+        addIfCheck(kingSq(turn), kingAttack(kingSq(turn)) & (~allBB));
+    }
+}
+
+bool Position::isLegal(Move move){
+    // Assumes the move is pseudo-legal (the piece can move like this if we ignore checks and pins)
+    Square st = moveFrom(move);
+    Square en = moveTo(move);
+    Square king = kingSq(turn);
+    Bitboard checkers = pos[stk].checkers;
+
+    // King moves can't go to attacked squares (and castling can't be out of or through check)
+    if (movePieceType(move) == KING){
+        if (abs(getFile(st) - getFile(en)) == 2){
+            return !checkers
+                   and !(attackersTo((st + en) / 2, allBB) & colorBB[!turn])
+                   and !(attackersTo(en, allBB) & colorBB[!turn]);
+        }
+        return !(attackersTo(en, allBB ^ (1ULL << st)) & colorBB[!turn]);
+    }
+
+    // Only the king can move in double check
+    if (countOnes(checkers) >= 2){
+        return false;
+    }
+
+    // En passant removes 2 pieces from a line so just see if anything attacks our king afterwards
+    if (isEP(move)){
+        Square captSq = (turn == WHITE ? en - 8 : en + 8);
+        Bitboard occupancyAfter = (allBB ^ (1ULL << st) ^ (1ULL << en) ^ (1ULL << captSq));
+
+        return !(attackersTo(king, occupancyAfter) & colorBB[!turn] & ~(1ULL << captSq));
+    }
+
+    // Single check must be captured or blocked
+    if (checkers and !((getLine(lsb(checkers), king) | checkers) & (1ULL << en))){
+        return false;
+    }
+
+    // Pinned pieces can only move along the pin
+    return !(pos[stk].blockers[turn] & (1ULL << st)) or onSameRay(king, st, en);
+}
+
+bool Position::givesCheck(Move move){
+    // Assumes the move is legal
+    Square st = moveFrom(move);
+    Square en = moveTo(move);
+    Piece promo = movePromo(move);
+    Piece pieceType = movePieceType(move);
+    Square enemyKing = kingSq(!turn);
+
+    // Direct check
+    if (!promo and (pos[stk].checkSquares[pieceType] & (1ULL << en))){
+        return true;
+    }
+
+    // Discovered check
+    if ((pos[stk].blockers[!turn] & (1ULL << st)) and !onSameRay(enemyKing, st, en)){
+        return true;
+    }
+
+    // Promotion (the pawn may have been blocking the promoted piece's line to the king)
+    if (promo){
+        Bitboard occupancy = allBB ^ (1ULL << st);
+
+        return (promo == KNIGHT and (knightAttack(en) & pieceBB[KING][!turn]))
+               or ((promo == BISHOP or promo == QUEEN) and (bishopAttack(en, occupancy) & pieceBB[KING][!turn]))
+               or ((promo == ROOK or promo == QUEEN) and (rookAttack(en, occupancy) & pieceBB[KING][!turn]));
+    }
+
+    // En passant (the captured pawn may have been blocking a slider)
+    if (isEP(move)){
+        Square captSq = (turn == WHITE ? en - 8 : en + 8);
+        Bitboard occupancy = (allBB ^ (1ULL << st) ^ (1ULL << en) ^ (1ULL << captSq));
+
+        return (bishopAttack(enemyKing, occupancy) & (pieceBB[BISHOP][turn] | pieceBB[QUEEN][turn]))
+               or (rookAttack(enemyKing, occupancy) & (pieceBB[ROOK][turn] | pieceBB[QUEEN][turn]));
+    }
+
+    // Castling (the rook may give check)
+    if (pieceType == KING and abs(getFile(st) - getFile(en)) == 2){
+        Square stRook = (st < en ? st + 3 : st - 4);
+        Square enRook = (st < en ? st + 1 : st - 1);
+        Bitboard occupancy = (allBB ^ (1ULL << st) ^ (1ULL << stRook)) | (1ULL << en) | (1ULL << enRook);
+
+        return rookAttack(enRook, occupancy) & pieceBB[KING][!turn];
+    }
+    return false;
+}
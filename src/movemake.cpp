@@ -73,6 +73,7 @@ void Position::makeMove(Move move){
     pos[stk].zhash = pos[stk - 1].zhash;
 
     pos[stk].halfMoveClock = pos[stk - 1].halfMoveClock;
+    pos[stk].pliesFromNull = pos[stk - 1].pliesFromNull + 1;
     pos[stk].moveCount = pos[stk - 1].moveCount;
     
     pos[stk].nnue = pos[stk - 1].nnue;
@@ -146,11 +147,15 @@ void Position::makeMove(Move move){
 
     // Step 8f) Update zhash
     pos[stk].zhash ^= ttRngCastle[pos[stk].castleRights] ^ ttRngEnpass[pos[stk].epFile] ^ ttRngTurn;
+    keyHistory[stk] = pos[stk].zhash;
 
     // Step 9) If our king is in a different bucket, we must refresh our NNUE
     if (refresh){
         pos[stk].nnue.refresh(board, kingSq(WHITE), kingSq(BLACK));
     }
+
+    // Step 10) Checkers, pins, and check squares for the new position
+    calcCheckInfo();
 }
 
 void Position::undoLastMove(){
@@ -220,13 +225,18 @@ void Position::makeNullMove(){
     pos[stk].epFile = NO_EP;
 
     pos[stk].halfMoveClock = pos[stk - 1].halfMoveClock + 1;
+    pos[stk].pliesFromNull = 0;
     pos[stk].moveCount = pos[stk - 1].moveCount + 1;
 
     pos[stk].zhash = pos[stk - 1].zhash ^ ttRngTurn ^ ttRngEnpass[pos[stk - 1].epFile] ^ ttRngEnpass[pos[stk].epFile];
+    keyHistory[stk] = pos[stk].zhash;
 
     pos[stk].nnue = pos[stk - 1].nnue;
 
     turn ^= 1;
+
+    // Check squares are from the new side to move's perspective
+    calcCheckInfo();
 }
 
 void Position::undoNullMove(){
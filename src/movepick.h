@@ -43,6 +43,6 @@ inline Piece movePromo(Move move){
 }
 
 // Encode based on the above encoding
-inline Move encodeMove(Square st, Square en, Square promo){
+constexpr Move encodeMove(Square st, Square en, Square promo){
     return st + (static_cast<Move>(en) << 6) + (static_cast<Move>(promo) << 12);
 }
\ No newline at end of file
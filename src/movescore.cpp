@@ -91,9 +91,9 @@ void scoreMoves(moveList &moves, Move ttMove, Depth ply, Position &board, Search
             score = COUNTER_SCORE;
         }
 
-        // Step 7) Rest of the moves
+        // Step 7) Rest of the moves (quiet checks are tried a bit earlier)
         else{
-            score = NONSPECIAL_MOVE_SCORE + getQuietHistory(move, ply, board, sd, ss);
+            score = NONSPECIAL_MOVE_SCORE + getQuietHistory(move, ply, board, sd, ss) + QUIET_CHECK_BONUS * board.givesCheck(move);
         }
     }
 }
\ No newline at end of file
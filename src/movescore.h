@@ -27,6 +27,11 @@ const Movescore OKAY_THRESHOLD_SCORE     = 1350000000;
 const Movescore BAD_CAPT_SCORE           = 1300000000;
 
 const Movescore PROMO_SCORE_BONUS[7] = { 0, 0, 1, 2, 3, 4, 0 };
+const Movescore QUIET_CHECK_BONUS = 8192;
+
+// Quiet history is at most 5 * MAXIMUM_HIST in size so every quiet move (and so every quiet check in qsearch)
+// stays above OKAY_THRESHOLD_SCORE and only bad captures are cut off by qsearch SEE pruning
+static_assert(NONSPECIAL_MOVE_SCORE - 5 * MAXIMUM_HIST > OKAY_THRESHOLD_SCORE, "Quiet moves must stay above the okay threshold");
 
 Movescore getQuietHistory(Move move, Depth ply, Position &board, SearchData &sd, SearchStack *ss);
 void updateAllHistory(Move bestMove, moveList &quiets, Depth depth, Depth ply, Position &board, SearchData &sd, SearchStack *ss);
@@ -0,0 +1,236 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "packed.h"
+#include "board.h"
+#include "helpers.h"
+#include "uci.h"
+
+// Number of records read or written at a time by the converter
+static const int CONVERT_BUFFER_SIZE = 4096;
+
+PackedPosition Position::pack(Score whiteScore, uint8 result){
+    PackedPosition packed = {};
+    packed.occupancy = allBB;
+
+    // Pieces in the order of the occupancy bits
+    Bitboard occupied = allBB;
+
+    for (int i = 0; occupied; i++){
+        Square sq = poplsb(occupied);
+        packed.pieces[i / 2] |= board[sq] << (4 * (i & 1));
+    }
+
+    packed.score = whiteScore;
+    packed.fullMoveNumber = pos[stk].moveCount / 2 + 1;
+    packed.halfMoveClock = pos[stk].halfMoveClock;
+    packed.turnAndCastle = turn | (pos[stk].castleRights << 1);
+    packed.epFile = pos[stk].epFile;
+    packed.result = result;
+
+    return packed;
+}
+
+bool Position::unpack(const PackedPosition &packed){
+    // Step 1) Check the record first since it comes from a file (only real pieces, one king per side, no
+    // pawns on the back ranks, castle rights with the king and rook at home, and a possible en passant file)
+    if (countOnes(packed.occupancy) > 32 or (packed.epFile > 7 and packed.epFile != NO_EP) or packed.result > PACKED_WHITE_WIN){
+        return false;
+    }
+    Piece squares[64] = {};
+    int kings[2] = {};
+    Bitboard occupied = packed.occupancy;
+
+    for (int i = 0; occupied; i++){
+        Square sq = poplsb(occupied);
+        Piece piece = (packed.pieces[i / 2] >> (4 * (i & 1))) & 15;
+
+        if (getPieceType(piece) < PAWN or getPieceType(piece) > KING
+            or (getPieceType(piece) == PAWN and (sq < 8 or sq >= 56)))
+        {
+            return false;
+        }
+        kings[getPieceColor(piece)] += (getPieceType(piece) == KING);
+        squares[sq] = piece;
+    }
+    if (kings[WHITE] != 1 or kings[BLACK] != 1){
+        return false;
+    }
+
+    Color side = packed.turnAndCastle & 1;
+    int castleRights = (packed.turnAndCastle >> 1) & 15;
+    const Square kingSquares[4] = {SQ_E1, SQ_E1, SQ_E8, SQ_E8};
+    const Square rookSquares[4] = {SQ_H1, SQ_A1, SQ_H8, SQ_A8};
+
+    for (int i = 0; i < 4; i++){
+        Color color = (i < 2 ? WHITE : BLACK);
+
+        if ((castleRights >> i & 1)
+            and (squares[kingSquares[i]] != (KING << 1) + color or squares[rookSquares[i]] != (ROOK << 1) + color))
+        {
+            return false;
+        }
+    }
+    if (packed.epFile != NO_EP){
+        Square target = packed.epFile + (side == WHITE ? SQ_A6 : SQ_A3);
+        Square pawn = target + (side == WHITE ? -8 : 8);
+
+        if (squares[target] or squares[pawn] != (PAWN << 1) + !side){
+            return false;
+        }
+    }
+
+    // Step 2) Reset everything that must be reset
+    clearPosition();
+
+    // Step 3) Fill the board
+    occupied = packed.occupancy;
+
+    while (occupied){
+        Square sq = poplsb(occupied);
+        addPiece(getPieceType(squares[sq]), sq, getPieceColor(squares[sq]), false);
+    }
+
+    // Step 4) Turn, castle rights, en passant, and clocks
+    turn = side;
+    pos[stk].castleRights = castleRights;
+    pos[stk].epFile = packed.epFile;
+    pos[stk].halfMoveClock = packed.halfMoveClock;
+    pos[stk].moveCount = (std::max<int>(packed.fullMoveNumber, 1) - 1) * 2 + turn;
+
+    // Step 5) Hash, NNUE, and check info
+    finishSetup();
+    return true;
+}
+
+bool textToPacked(Position &board, const std::string &line, PackedPosition &packed){
+    // Fields are seperated by '|' (score and result are optional)
+    std::vector<std::string> fields;
+    size_t start = 0;
+
+    while (true){
+        size_t end = line.find('|', start);
+        fields.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+
+        if (end == std::string::npos){
+            break;
+        }
+        start = end + 1;
+    }
+    // Blank lines, bad FENs, and scores that aren't a number are skipped
+    std::string error;
+    int score = 0;
+
+    if (fields[0].find_first_not_of(" \t\r") == std::string::npos or !checkFen(fields[0], error)){
+        return false;
+    }
+    if (fields.size() >= 2){
+        std::istringstream scoreStream(fields[1]);
+
+        if (!(scoreStream >> score) or std::abs(score) > 32767){
+            return false;
+        }
+    }
+    board.readFen(fields[0]);
+
+    uint8 result = PACKED_DRAW;
+
+    if (fields.size() >= 3){
+        std::istringstream iss(fields[2]);
+        std::string resultStr;
+        iss >> resultStr;
+
+        if (resultStr == "1.0" or resultStr == "1" or resultStr == "1-0"){
+            result = PACKED_WHITE_WIN;
+        }
+        else if (resultStr == "0.0" or resultStr == "0" or resultStr == "0-1"){
+            result = PACKED_BLACK_WIN;
+        }
+    }
+    packed = board.pack(score, result);
+    return true;
+}
+
+bool packedToText(Position &board, const PackedPosition &packed, std::string &text){
+    if (!board.unpack(packed)){
+        return false;
+    }
+    std::string result = packed.result == PACKED_WHITE_WIN ? "1.0" : packed.result == PACKED_BLACK_WIN ? "0.0" : "0.5";
+    text = board.getFen() + " | " + std::to_string(packed.score) + " | " + result;
+    return true;
+}
+
+void runConvertCommand(std::istringstream &iss){
+    std::string direction, inFile, outFile;
+    iss >> direction >> inFile >> outFile;
+
+    if ((direction != "fen2packed" and direction != "packed2fen") or inFile.empty() or outFile.empty()){
+        std::cout << "usage: convert [fen2packed | packed2fen] <infile> <outfile>" << std::endl;
+        return;
+    }
+
+    std::ifstream in(inFile, direction == "fen2packed" ? std::ios::in : std::ios::binary);
+    std::ofstream out(outFile, direction == "fen2packed" ? std::ios::binary : std::ios::out);
+
+    if (!in or !out){
+        std::cout << "convert: could not open " << (!in ? inFile : outFile) << std::endl;
+        return;
+    }
+
+    Position board;
+    std::vector<PackedPosition> buffer(CONVERT_BUFFER_SIZE);
+    uint64 records = 0, skipped = 0;
+    TimePoint startTime = getTime();
+
+    if (direction == "fen2packed"){
+        std::string line;
+        int count = 0;
+
+        while (std::getline(in, line)){
+            if (textToPacked(board, line, buffer[count])){
+                count++;
+                records++;
+            }
+            else if (line.find_first_not_of(" \t\r") != std::string::npos){
+                skipped++;
+            }
+            if (count == CONVERT_BUFFER_SIZE){
+                out.write(reinterpret_cast<const char*>(buffer.data()), count * sizeof(PackedPosition));
+                count = 0;
+            }
+        }
+        out.write(reinterpret_cast<const char*>(buffer.data()), count * sizeof(PackedPosition));
+    }
+    else{
+        std::string text, record;
+
+        while (in.read(reinterpret_cast<char*>(buffer.data()), CONVERT_BUFFER_SIZE * sizeof(PackedPosition)) or in.gcount()){
+            int count = in.gcount() / sizeof(PackedPosition);
+            text.clear();
+
+            for (int i = 0; i < count; i++){
+                if (packedToText(board, buffer[i], record)){
+                    text += record + "\n";
+                    records++;
+                }
+                else{
+                    skipped++;
+                }
+            }
+            out << text;
+        }
+    }
+    TimePoint time = getTime() - startTime;
+
+    std::cout << "converted " << records << " records in " << time / 1000 << " ms ("
+              << static_cast<uint64>(records * 1000000.0 / (time + 1)) << " records/s)";
+
+    if (skipped){
+        std::cout << ", skipped " << skipped << " bad records";
+    }
+    std::cout << std::endl;
+}
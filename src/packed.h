@@ -0,0 +1,36 @@
+#pragma once
+
+#include <sstream>
+#include "types.h"
+
+class Position;
+
+// Fixed size (32 byte) training data record. Pieces are stored in the order of the set bits of the
+// occupancy (4 bits each, low nibble first) using our piece encoding ((type << 1) + color) so there
+// is room for all 32 pieces. Score is in centipawns and score and result are from white's view
+
+const uint8 PACKED_BLACK_WIN = 0;
+const uint8 PACKED_DRAW = 1;
+const uint8 PACKED_WHITE_WIN = 2;
+
+struct PackedPosition{
+    uint64 occupancy;
+    uint8 pieces[16];
+    Score score;
+    uint16 fullMoveNumber;
+    uint8 halfMoveClock;
+    uint8 turnAndCastle;    // Bit 0 is the side to move and bits [1...4] are the castle rights
+    uint8 epFile;           // NO_EP if there is no en passant square
+    uint8 result;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
+// Text records are "fen | score | result" (the format written by datagen) where result is 1.0, 0.5, or 0.0.
+// Both return false for a record that isn't a legal position (Position::unpack checks packed records)
+bool textToPacked(Position &board, const std::string &line, PackedPosition &packed);
+bool packedToText(Position &board, const PackedPosition &packed, std::string &text);
+
+// Command: convert [fen2packed | packed2fen] <infile> <outfile>
+// Streams records between the text format and the packed format (bad records are skipped and counted)
+void runConvertCommand(std::istringstream &iss);
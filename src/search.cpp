@@ -2,19 +2,25 @@
 #include "timecontrol.h"
 #include "movescore.h"
 #include "uci.h"
+#include "syzygy.h"
 #include <math.h>
 #include <thread>
+#include <atomic>
 #include <vector>
 #include <cstring>
 #include <memory>
+#include <map>
+#include <algorithm>
+
+SearchEngine globalEngine;
 
-static timeMan tm;
-static uint64 nodeLim;
-static std::vector<std::thread> threads;
-static std::vector<SearchData> threadSD;
 static Depth lmrReduction[MAX_PLY + 5][MAX_MOVES_IN_TURN];
 
-bool pondering = false;
+// Lazy SMP depth skipping schedule (indexed by helper thread id). A helper skips an iteration
+// if ((depth + SKIP_PHASE) / SKIP_SIZE) is odd so threads search different depths at the same time
+static const int SMP_SKIP_TABLE_SIZE = 20;
+static const int SKIP_SIZE[SMP_SKIP_TABLE_SIZE] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SKIP_PHASE[SMP_SKIP_TABLE_SIZE] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
 
 void initLMR(){
     for (Depth depth = 1; depth <= MAX_PLY; depth++){
@@ -24,9 +30,7 @@ void initLMR(){
     }
 }
 
-void setThreadCount(int tds){
-    threadCount = tds;
-
+void SearchEngine::setThreadCount(int tds){
     // Vector assign doesn't work with threads
     while (static_cast<int>(threads.size()) < tds){
         threads.emplace_back();
@@ -36,43 +40,85 @@ void setThreadCount(int tds){
         threads.pop_back();
         threadSD.pop_back();
     }
+    for (SearchData &sd : threadSD){
+        sd.engine = this;
+        sd.tt = &tt;
+        sd.persistentTT = persistentSize ? &persistentTT : nullptr;
+    }
 }
 
-void resetAllSearchDataNonHistory(){
-    for (int td = 0; td < threadCount; td++){
+void SearchEngine::setPersistentSize(int megabytes){
+    persistentSize = megabytes;
+
+    if (persistentSize){
+        persistentTT.setSize(persistentSize);
+    }
+    setThreadCount(getThreadCount());
+}
+
+int SearchEngine::getThreadCount(){
+    return threadSD.size();
+}
+
+void SearchEngine::resetNonHistory(){
+    for (int td = 0; td < getThreadCount(); td++){
         threadSD[td].resetNonHistory(td);
     }
 }
 
-void decayAllSearchDataHistory(){
-    for (int td = 0; td < threadCount; td++){
-        threadSD[td].decayHistory();
+void SearchEngine::decayHistory(){
+    for (SearchData &sd : threadSD){
+        sd.decayHistory();
     }
 }
 
-void clearAllSearchDataHistory(){
-    for (int td = 0; td < threadCount; td++){
-        threadSD[td].clearHistory();
+void SearchEngine::clearHistory(){
+    for (SearchData &sd : threadSD){
+        sd.clearHistory();
     }
 }
 
-void endSearch(){
-    tm.forceStop = true;
+void SearchEngine::stop(){
+    stopFlag.store(true, std::memory_order_relaxed);
+}
+
+void SearchEngine::ponderHit(){
+    // The budget has to be rebased before the search sees that we stopped pondering
+    if (pondering){
+        tm.ponderhit();
+        pondering = false;
+    }
+}
+
+uint64 SearchEngine::totalNodes(){
+    uint64 nodeCount = 0;
+
+    for (SearchData &sd : threadSD){
+        nodeCount += sd.nodes;
+    }
+    return nodeCount;
+}
+
+static inline double bestMoveNodeFraction(SearchData &sd){
+    return sd.rootMoves.empty() ? 0.0 : static_cast<double>(sd.rootMoves[0].nodes) / (sd.nodes + 1.0);
 }
 
 static inline void checkEnd(SearchData &sd){
-    sd.stopped = tm.stopDuringSearch();
+    // Independent searches only look at their own nodes and time
+    if (sd.independent){
+        sd.stopped = (sd.independentNodeLim and sd.nodes >= sd.independentNodeLim)
+                  or (sd.independentTimeLim and getTime() - sd.independentStartTime >= sd.independentTimeLim);
+        return;
+    }
+    // Thread 0 checks the time and node limits
+    SearchEngine &engine = *sd.engine;
 
-    // If we have a node limit and are at thread 0, check our node count
-    if (nodeLim and sd.threadId == 0){
-        uint64 nodeCount = 0;
-        for (int i = 0; i < threadCount; i++){
-            nodeCount += threadSD[i].nodes;
-        }
-        if (nodeCount >= nodeLim){
-            sd.stopped = true;
-        }
+    if (sd.threadId == 0
+        and ((!engine.pondering and engine.tm.stopDuringSearch(bestMoveNodeFraction(sd))) or (engine.nodeLim and engine.totalNodes() >= engine.nodeLim)))
+    {
+        engine.stop();
     }
+    sd.stopped = engine.stopFlag.load(std::memory_order_relaxed);
 }
 
 static inline void adjustEval(ttEntry &tte, Score &staticEval){
@@ -87,7 +133,7 @@ static inline void adjustEval(ttEntry &tte, Score &staticEval){
     }
 }
 
-template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, Position &board, SearchData &sd, SearchStack *ss){
+template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, Depth depth, Position &board, SearchData &sd, SearchStack *ss){
     // Step 1) Leaf node and misc stuff
     // Update information and check if we should stop
 
@@ -106,11 +152,23 @@ template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, P
         return board.eval();
     }
 
+    // If we can force a repetition of a position in the search then we have at least a draw
+    if (alpha < 0 and board.upcomingRepetition(ply)){
+        alpha = 1 - (sd.nodes & 2);
+
+        if (alpha >= beta){
+            return alpha;
+        }
+    }
+
     // Step 2) Probe the TT and initalize variables
     // Get TT values and other variables and check if we can end early
 
     ttEntry tte = ttEntry();
-    bool foundEntry = globalTT.probe(board.getHash(), tte, ply);
+    bool foundEntry = sd.tt->probe(board.getHash(), tte, ply);
+
+    STATS_INC(sd, qsNodes);
+    STATS_ADD(sd, qsTTHits, foundEntry);
 
     Score originalAlpha = alpha;
     bool inCheck = board.inCheck();
@@ -131,7 +189,7 @@ template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, P
     // static eval based on TT. Also do the qsearch standing pat heuristic
 
     if (!inCheck){
-        ss->staticEval = foundEntry ? tte.staticEval : board.eval();
+        ss->staticEval = (foundEntry and tte.staticEval != NO_SCORE) ? tte.staticEval : board.eval();
 
         // Adjust static eval based on TT (~10 elo)
         // Don't do it if we have mate score and are at PV or else we will return improper mating PV list
@@ -152,10 +210,15 @@ template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, P
     // Step 4) Move gen and related 
     // Note that we don't consider draws in qsearch and we generate ALL MOVES when in check. This means
     // we return mate score if it's mate. Also, we don't have to worry about improper PV list since a
-    // mate score will never be propagated to the root of the QS due to maxing alpha with static eval
+    // mate score will never be propagated to the root of the QS due to maxing alpha with static eval.
+    // At the first ply of qsearch we also look at quiet moves that give check
 
     moveList moves;
     board.genAllMoves(!inCheck, moves);
+
+    if (!inCheck and depth == 0){
+        board.genQuietChecks(moves);
+    }
     
     if (moves.sz == 0){
         return inCheck ? -(CHECKMATE_SCORE - ply) : ss->staticEval;
@@ -179,8 +242,9 @@ template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, P
 
         // Step 7) SEE Pruning (~6.5 elo)
         // Skip moves with bad SEE. First if statement skips all moves the moment
-        // we hit a losing move determined in move ordering. The second statement
-        // ignores all moves with a losing SEE including quiet moves 
+        // we hit a losing move determined in move ordering (quiet checks are scored above
+        // that so they are all tried). The second statement ignores all moves with a losing
+        // SEE including quiet checks that hang the checking piece
 
         if (bestScore > -FOUND_MATE and mscore < OKAY_THRESHOLD_SCORE){
             break;
@@ -198,12 +262,12 @@ template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, P
         sd.nodes++;
 
         board.makeMove(move);
-        globalTT.prefetch(board.getHash());
+        sd.tt->prefetch(board.getHash());
 
         // Step 9) Recurse
         // Simple stuff, no zero window
 
-        Score score = -qsearch<pvNode>(-beta, -alpha, ply + 1, board, sd, ss + 1);
+        Score score = -qsearch<pvNode>(-beta, -alpha, ply + 1, depth - 1, board, sd, ss + 1);
 
         // Step 10) Undo and update
         // Undo and see if we raise alpha or have a beta cutoff
@@ -244,7 +308,7 @@ template<bool pvNode> static Score qsearch(Score alpha, Score beta, Depth ply, P
         else if (bestScore >= beta){
             bound = BOUND_LOWER;
         }
-        globalTT.addToTT(board.getHash(), bestScore, ss->staticEval, bestMove, 0, ply,bound, pvNode);
+        sd.tt->addToTT(board.getHash(), bestScore, ss->staticEval, bestMove, 0, ply,bound, pvNode);
     }
     return bestScore;
 }
@@ -266,11 +330,20 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         return board.eval();
     }
     if (depth <= 0){
-        return qsearch<pvNode>(alpha, beta, ply, board, sd, ss);
+        return qsearch<pvNode>(alpha, beta, ply, 0, board, sd, ss);
     }
     if (board.drawByRepetition(ply) or board.drawByInsufficientMaterial() or board.drawByFiftyMoveRule()){
         return 1 - (sd.nodes & 2);
     }
+
+    // If we can force a repetition of a position in the search then we have at least a draw
+    if (ply > 0 and alpha < 0 and board.upcomingRepetition(ply)){
+        alpha = 1 - (sd.nodes & 2);
+
+        if (alpha >= beta){
+            return alpha;
+        }
+    }
     
     // Step 2) Mate distance pruning (~0.5 elo but good for finding mates)
     // We prunes trees that have no hope of improving our mate score (if we have one).
@@ -290,7 +363,15 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
     // Get TT values and other variables and check if we can end early
 
     ttEntry tte = ttEntry();
-    bool foundEntry = ss->excludedMove == NULL_OR_NO_MOVE ? globalTT.probe(board.getHash(), tte, ply) : false;
+    bool foundEntry = ss->excludedMove == NULL_OR_NO_MOVE ? sd.tt->probe(board.getHash(), tte, ply) : false;
+
+    // Deep entries that were replaced in the TT may still be in the persistent hash
+    if (!foundEntry and sd.persistentTT and depth >= PERSISTENT_PROBE_DEPTH and ss->excludedMove == NULL_OR_NO_MOVE){
+        foundEntry = sd.persistentTT->probe(board.getHash(), tte, ply);
+    }
+
+    STATS_INC(sd, nodes);
+    STATS_ADD(sd, ttHits, foundEntry);
 
     Score originalAlpha = alpha;
     bool inCheck = board.inCheck();
@@ -305,11 +386,59 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
             or (decodeBound(tte.ageAndBound) == BOUND_LOWER and tte.score >= beta)
             or (decodeBound(tte.ageAndBound) == BOUND_UPPER and tte.score <= alpha))
         {
+            STATS_INC(sd, ttCutoffs);
             return tte.score;
         }
     }
 
-    // Step 4) TT move reduction (aka internal "iterative" reduction) (~5 elo)
+    // Step 4) Tablebase probe
+    // With few enough pieces left, we get the result from the tablebases. Draws are exact but wins and
+    // losses are bounds since we don't know the distance to mate. We only probe right after a zeroing
+    // move since the tables don't know about the fifty move counter
+
+    Score bestScore = -CHECKMATE_SCORE;
+    Score maxScore = CHECKMATE_SCORE;
+    int pieceCount = countOnes(board.allPieces());
+
+    if (ply > 0
+        and ss->excludedMove == NULL_OR_NO_MOVE
+        and pieceCount <= sd.tbCardinality
+        and (pieceCount < sd.tbCardinality or depth >= sd.tbProbeDepth)
+        and board.getHalfMoveClock() == 0
+        and !board.getCastleRights())
+    {
+        ProbeState result;
+        int wdl = probeWDL(board, result);
+
+        if (result != PROBE_FAIL){
+            sd.tbHits++;
+
+            // Cursed wins and blessed losses are draws due to the fifty move rule
+            Score score = wdl < WDL_BLESSED_LOSS ? -TB_WIN_SCORE + ply : (wdl > WDL_CURSED_WIN ? TB_WIN_SCORE - ply : 2 * wdl);
+            TTboundAge bound = wdl < WDL_BLESSED_LOSS ? BOUND_UPPER : (wdl > WDL_CURSED_WIN ? BOUND_LOWER : BOUND_EXACT);
+
+            if (bound == BOUND_EXACT
+                or (bound == BOUND_LOWER and score >= beta)
+                or (bound == BOUND_UPPER and score <= alpha))
+            {
+                sd.tt->addToTT(board.getHash(), score, NO_SCORE, NULL_OR_NO_MOVE, std::min(MAX_PLY - 1, depth + 6), ply, bound, pvNode);
+                return score;
+            }
+
+            // At PV nodes we keep searching for the actual score but it can't be past the TB bound
+            if (pvNode){
+                if (bound == BOUND_LOWER){
+                    bestScore = score;
+                    alpha = std::max(alpha, score);
+                }
+                else{
+                    maxScore = score;
+                }
+            }
+        }
+    }
+
+    // Step 5) TT move reduction (aka internal "iterative" reduction) (~5 elo)
     // If we don't have a TT move, we reduce by 1
 
     if ((pvNode or cutNode)
@@ -320,17 +449,17 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         depth--;
     }
 
-    // Step 5) Static eval and improving
+    // Step 6) Static eval and improving
     // Get the static evaluation if not in TT and see if we are improving by comparing static eval with
     // that of 2 plies ago. Note that adjusting eval here based on TT like what we did in qsearch
     // loses elo for some unknown reason...
 
     if (!inCheck){
-        ss->staticEval = foundEntry ? tte.staticEval : board.eval();
+        ss->staticEval = (foundEntry and tte.staticEval != NO_SCORE) ? tte.staticEval : board.eval();
     }
     bool improving = (!inCheck and (ply >= 2 and ((ss - 2)->staticEval == NO_SCORE or ss->staticEval > (ss - 2)->staticEval)));
 
-    // Step 6) Reverse Futility Pruning (~75 elo)
+    // Step 7) Reverse Futility Pruning (~75 elo)
     // If the static evaluation is far above beta, we can assume that it will fail high
 
     if (!pvNode 
@@ -339,10 +468,11 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         and depth <= 8
         and ss->staticEval - 77 * std::max(depth - improving, 0) >= beta)
     {
+        STATS_INC(sd, rfp);
         return ss->staticEval;
     }
 
-    // Step 7) TT based razoring (~4 elo)
+    // Step 8) TT based razoring (~4 elo)
     // At nodes near the leaf, we can see if the tt score puts us far below alpha. If so
     // we assume that it will be impossible to raise it to alpha.
     
@@ -354,10 +484,11 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         and (decodeBound(tte.ageAndBound) == BOUND_UPPER or decodeBound(tte.ageAndBound) == BOUND_EXACT) 
         and tte.score + 180 * depth * depth <= alpha)
     {
+        STATS_INC(sd, razoring);
         return tte.score;
     }
 
-    // Step 8) Null Move Pruning (~60 elo)
+    // Step 9) Null Move Pruning (~60 elo)
     // We evaluate the position if we skipped our turn and check if doing so
     // causes a beta cutoff via the zero window [beta - 1, beta]
 
@@ -369,12 +500,14 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         and (ply >= 1 and (ss - 1)->move != NULL_OR_NO_MOVE)
         and board.hasMajorPieceLeft(board.getTurn()))
     {
+        STATS_INC(sd, nmpTried);
+
         // Make move and update variables
         ss->move = NULL_OR_NO_MOVE;
         sd.nodes++;
 
         board.makeNullMove();
-        globalTT.prefetch(board.getHash());
+        sd.tt->prefetch(board.getHash());
         
         Depth R = 3 + (depth / 3) + std::min(static_cast<int>(ss->staticEval - beta) / 200, 3);
         
@@ -386,6 +519,8 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
 
         // See if score is above beta
         if (score >= beta){
+            STATS_INC(sd, nmpCutoffs);
+
             // Don't use mate score
             if (score >= FOUND_MATE){
                 score = beta;
@@ -394,7 +529,7 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         }
     }
     
-    // Step 9) Probcut (~11.5 elo)
+    // Step 10) Probcut (~11.5 elo)
     // probCutBeta is a calculated value above beta. We try promising tactical moves and if any
     // of them have a score higher than probCutBeta at a reduced depth then we can assume that move will 
     // will have a score higher than beta at a normal depth
@@ -408,6 +543,8 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         and abs(beta) < FOUND_MATE 
         and !(foundEntry and tte.score < probCutBeta and tte.depth + 3 >= depth))
     {
+        STATS_INC(sd, probcutTried);
+
         // We only try noisy moves
         moveList probCutMoves;
         board.genAllMoves(true, probCutMoves);
@@ -430,10 +567,10 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
             sd.nodes++;
 
             board.makeMove(move);
-            globalTT.prefetch(board.getHash());
+            sd.tt->prefetch(board.getHash());
 
             // Verify with QS
-            Score score = -qsearch<false>(-probCutBeta, -(probCutBeta - 1), ply + 1, board, sd, ss + 1);
+            Score score = -qsearch<false>(-probCutBeta, -(probCutBeta - 1), ply + 1, 0, board, sd, ss + 1);
             
             // If verified, normal search with reduced depth
             if (score >= probCutBeta){
@@ -445,33 +582,45 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
 
             // Prune as this move will likely fail high when searched with a normal depth
             if (score >= probCutBeta){
+                STATS_INC(sd, probcutCutoffs);
+
                 // Store entry in TT
-                globalTT.addToTT(board.getHash(), score, ss->staticEval, move, depth - 3, ply, BOUND_LOWER, pvNode);
+                sd.tt->addToTT(board.getHash(), score, ss->staticEval, move, depth - 3, ply, BOUND_LOWER, pvNode);
                 return score;
             }
         }
     }
     
-    // Step 10) Generate moves, end of game checking, and move scoring
-    // Generate moves and if we have 0 moves then the game ended. Also score the moves...
+    // Step 11) Generate moves, end of game checking, and move scoring
+    // Generate moves and if we have 0 moves then the game ended. Also score the moves. At the root we
+    // only search the root moves of the current MultiPV line onwards in their current order (which is
+    // sorted by the results of the last search)
 
     moveList moves, quiets;
-    board.genAllMoves(false, moves);
-     
+
+    if (ply == 0){
+        for (int i = sd.pvIdx; i < static_cast<int>(sd.rootMoves.size()); i++){
+            moves.addMove(sd.rootMoves[i].move);
+            moves.moves[moves.sz - 1].score = MAX_MOVES_IN_TURN - i;
+        }
+    }
+    else{
+        board.genAllMoves(false, moves);
+        scoreMoves(moves, foundEntry ? tte.bestMove : NULL_OR_NO_MOVE, ply, board, sd, ss);
+    }
+    
     if (moves.sz == 0){
         return inCheck ? -(CHECKMATE_SCORE - ply) : 0;
     }
-    scoreMoves(moves, foundEntry ? tte.bestMove : NULL_OR_NO_MOVE, ply, board, sd, ss);
 
-    // Step 11) Iterate over the moves
+    // Step 12) Iterate over the moves
     // Pretty self explanatory...
 
-    Score bestScore = -CHECKMATE_SCORE;
     Move bestMove = NULL_OR_NO_MOVE;
     int movesSeen = 0;
 
     for (int i = 0; i < moves.sz; i++){
-        // Step 12) Variable stuff
+        // Step 13) Variable stuff
         // Bring best move forwards and declare necessary variables and do updates
 
         moves.bringBest(i);
@@ -488,68 +637,80 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
 
         bool ttSoundCapt = (foundEntry and tte.depth > 0 and board.moveCaptType(tte.bestMove) != NO_PIECE);
         bool isQuiet = movePromo(move) == NO_PIECE and board.moveCaptType(move) == NO_PIECE;
+        bool givesCheck = board.givesCheck(move);
         bool killerOrCounter = (move == sd.killers[ply][0] or move == sd.killers[ply][1] or (ply >= 1 and (ss - 1)->move != NULL_OR_NO_MOVE and move == *((ss - 1)->counter)));
 
         movesSeen++;
+        STATS_INC(sd, movesConsidered);
 
         if (isQuiet){
             quiets.addMove(move);
             history = getQuietHistory(move, ply, board, sd, ss);
         }
         
-        // Step 13) Quiet move pruning (~70 elo)
+        // Step 14) Quiet move pruning (~70 elo)
         // We skip quiet moves for various reasons. Note that we use lmrDepth for futility pruning and history based
         // pruning because we want the lateness in move ordering to affect pruning. However, there is no need to use
-        // lmrDepth in move count pruning since we are literally pruning nodes if they are late...
+        // lmrDepth in move count pruning since we are literally pruning nodes if they are late. Root moves are
+        // never pruned since a skipped root move would keep its score from the last iteration
 
-        if (isQuiet and bestScore > -FOUND_MATE and !inCheck){
+        if (ply > 0 and isQuiet and bestScore > -FOUND_MATE and !inCheck){
             Depth lmrDepth = std::max(1, depth - lmrReduction[depth][i]);
 
             // A) Quiet Move Count Pruning (~14 elo)
-            // If we are at low depth and searched enough quiet moves we can stop searching all other quiet moves
+            // If we are at low depth and searched enough quiet moves we can skip the other quiet moves that
+            // don't give check
 
-            if (depth <= 4
+            if (!givesCheck
+                and depth <= 4
                 and quiets.sz >= 1 + 3 * depth * depth + improving)
             {
+                STATS_INC(sd, lmp);
                 continue;
             }
 
             // B) Futility Pruning (~20 elo)
-            // Skip quiet moves if we are way below alpha
+            // Skip quiet moves if we are way below alpha (checks may change the evaluation by a lot)
 
-            if (lmrDepth <= 4
+            if (!givesCheck
+                and lmrDepth <= 4
                 and ss->staticEval + 110 + 75 * lmrDepth + history / 160 < alpha)
             {
+                STATS_INC(sd, futility);
                 continue;
             }
 
             // C) History Based Pruning (~9 elo)
-            // Prune non-killer and non-counter quiet moves that have a bad history
+            // Prune non-killer, non-counter, and non-checking quiet moves that have a bad history
             
             if (!killerOrCounter
+                and !givesCheck
                 and lmrDepth <= 2
                 and history <= -1408 * depth - 256 * improving)
             {
+                STATS_INC(sd, historyPruning);
                 continue;
             }
         }
         
-        // Step 14) SEE Pruning (~25 elo)
+        // Step 15) SEE Pruning (~25 elo)
         // We skip moves with a bad SEE. More elo can be gained by treating quiet and noisy
         // moves differently
 
-        if (bestScore > -FOUND_MATE 
+        if (ply > 0
+            and bestScore > -FOUND_MATE 
             and depth <= 5
             and movesSeen >= 3)
         {
             Score cutoff = isQuiet ? -60 * depth : -55 * depth;
 
             if (!board.seeGreater(move, cutoff)){
+                STATS_INC(sd, seePruning);
                 continue;
             }
         }
 
-        // Step 15) Singular Extension and Multi-cut Pruning (~38 elo from SE + MCP, ~4 elo from DE, ~7 elo from Alpha NE)
+        // Step 16) Singular Extension and Multi-cut Pruning (~38 elo from SE + MCP, ~4 elo from DE, ~7 elo from Alpha NE)
         // If our TT move singularly performs better than all other moves at a reduced depth then we should extend
         // it. However, if a bunch of moves manage to fail high at a reduced depth then we can assume
         // that at least one of them will fail high at a normal depth
@@ -571,9 +732,12 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
             Score singularScore = negamax<false, cutNode>(singularBeta - 1, singularBeta, ply, singularDepth, board, sd, ss);
             ss->excludedMove = NULL_OR_NO_MOVE;
 
+            STATS_INC(sd, singularTried);
+
             // Our TT move is singular meaning it's better than all other moves by some margin
             if (singularScore < singularBeta){
                 extension = 1;
+                STATS_INC(sd, singularExtensions);
 
                 // Double extend if singular score is way worse than singular beta (meaning TT is way better than everyone else)
                 if (!pvNode
@@ -581,11 +745,13 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
                     and (ss - 1)->dextension <= 4)
                 {
                     extension = 2;
+                    STATS_INC(sd, doubleExtensions);
                 }
             }
 
             // Multicut -- our TT move and at least one other move fails high (at a reduced depth)
             else if (singularBeta >= beta){
+                STATS_INC(sd, multicut);
                 return singularBeta;
             }
             
@@ -605,9 +771,10 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
             else if (tte.score <= alpha and singularScore <= alpha){
                 extension = -1;
             }
+            STATS_ADD(sd, negativeExtensions, extension < 0);
         }
 
-        // Step 16) Make and update
+        // Step 17) Make and update
         // Update necessary info, make move, and prefetch
         
         ss->move = move;
@@ -617,9 +784,9 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         sd.nodes++;
 
         board.makeMove(move);
-        globalTT.prefetch(board.getHash());
+        sd.tt->prefetch(board.getHash());
 
-        // Step 17) Late Move Reduction (~175 elo)
+        // Step 18) Late Move Reduction (~175 elo)
         // Later moves are likely to fail low so we search them at a reduced depth
         // with zero window [alpha, alpha + 1]. We do a re-search if it does not fail low
 
@@ -638,6 +805,9 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
             // Decrease reduction if special quiet
             R -= killerOrCounter;
 
+            // Decrease reduction if we give check
+            R -= givesCheck;
+
             // Increase reduction if our TT move is a capture
             R += ttSoundCapt;
             
@@ -655,10 +825,13 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
             // Reduce as long as there is some reduction
             if (R >= 2){
                 score = -negamax<false, !cutNode>(-(alpha + 1), -alpha, ply + 1, depth + extension - R, board, sd, ss + 1);
+
+                STATS_INC(sd, lmrTried);
+                STATS_ADD(sd, lmrResearches, score > alpha);
             }
         }
 
-        // Step 18) Principle Variation Search
+        // Step 19) Principle Variation Search
         // We do this if LMR inconclusive or we didn't do LMR (note that score is initializd to inf)
 
         if (score > alpha){
@@ -673,19 +846,32 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
                         
                 // Zero window inconclusive (note that its only possible to enter this if pvNode)
                 if (score > alpha and score < beta){
+                    STATS_INC(sd, pvsResearches);
                     score = -negamax<true, false>(-beta, -alpha, ply + 1, depth + extension - 1, board, sd, ss + 1);
                 }
             }
         }
 
-        // Step 19) Unmake and update
+        // Step 20) Unmake and update
         // Undo and see if we raise alpha or have a beta cutoff and update necessary info
 
         board.undoLastMove();
 
-        // If at root, update amount of time we spent searching that move
-        if (ply == 0){
-            sd.moveNodeStat[moveFrom(move)][moveTo(move)] += sd.nodes - nodesBefore;
+        // If at root, update the root move. The first move and moves that raise alpha get their
+        // score and PV updated while all other moves get the lowest score (so sorting keeps their order)
+        if (ply == 0 and !sd.stopped){
+            RootMove &rm = sd.findRootMove(move);
+            rm.nodes += sd.nodes - nodesBefore;
+
+            if (movesSeen == 1 or score > alpha){
+                rm.score = score;
+                rm.selDepth = sd.selDepth;
+                rm.pv.assign(1, move);
+                rm.pv.insert(rm.pv.end(), sd.pvTable[1] + 1, sd.pvTable[1] + std::max(sd.pvLength[1], static_cast<Depth>(1)));
+            }
+            else{
+                rm.score = -CHECKMATE_SCORE;
+            }
         }
 
         if (score > bestScore){
@@ -710,6 +896,9 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
                 
                 // Beta cutoff
                 if (score >= beta){
+                    STATS_INC(sd, cutoffs);
+                    STATS_ADD(sd, firstMoveCutoffs, movesSeen == 1);
+
                     if (isQuiet){
                         updateAllHistory(move, quiets, depth, ply, board, sd, ss);
                     }
@@ -719,10 +908,14 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         }
     }
 
-    // Step 20) Update TT
-    // Put search results into TT 
+    // Step 21) Update TT
+    // Put search results into TT (root results of secondary MultiPV lines exclude moves so don't store them)
+
+    if (pvNode){
+        bestScore = std::min(bestScore, maxScore);
+    }
 
-    if (!sd.stopped and ss->excludedMove == NULL_OR_NO_MOVE){
+    if (!sd.stopped and ss->excludedMove == NULL_OR_NO_MOVE and !(ply == 0 and sd.pvIdx)){
         TTboundAge bound = BOUND_EXACT;
 
         if (bestScore <= originalAlpha){
@@ -731,7 +924,11 @@ template<bool pvNode, bool cutNode> static Score negamax(Score alpha, Score beta
         else if (bestScore >= beta){
             bound = BOUND_LOWER;
         }
-        globalTT.addToTT(board.getHash(), bestScore, ss->staticEval, bestMove, depth, ply, bound, pvNode);
+        sd.tt->addToTT(board.getHash(), bestScore, ss->staticEval, bestMove, depth, ply, bound, pvNode);
+
+        if (sd.persistentTT and depth >= PERSISTENT_MIN_DEPTH){
+            sd.persistentTT->addPersistent(board.getHash(), bestScore, ss->staticEval, bestMove, depth, ply, bound);
+        }
     }
     return bestScore;
 }
@@ -742,8 +939,9 @@ Score aspirationWindowSearch(Score prevEval, Depth depth, Position &board, Searc
     // to our previous evaluation so we search with a small window around
     // our previous evaluation and expand the window if it is inconclusive
 
-    // Init window and stack
-    int delta = 14;
+    // Init window and stack. Helper threads use slightly different window sizes
+    // so that their re-searches (and thus their trees) diverge from the main thread
+    int delta = 14 + 2 * (sd.threadId % 4);
     std::unique_ptr<SearchStack[]> searchArr = std::make_unique<SearchStack[]>(MAX_PLY + 5);
     SearchStack* ss = searchArr.get() + 2;
     
@@ -766,6 +964,9 @@ Score aspirationWindowSearch(Score prevEval, Depth depth, Position &board, Searc
         // Get score
         Score score = negamax<true, false>(alpha, beta, 0, depth, board, sd, ss);
 
+        // Bring the best root moves of this line forward
+        std::stable_sort(sd.rootMoves.begin() + sd.pvIdx, sd.rootMoves.end());
+
         // Out of time
         if (sd.stopped){
             break;
@@ -808,107 +1009,201 @@ Score aspirationWindowSearch(Score prevEval, Depth depth, Position &board, Searc
     return 0;
 }
 
-void printSearchResults(SearchResultData result){
+void SearchEngine::print(const std::string &line){
+    if (output){
+        output(line);
+    }
+    else{
+        std::cout << line << std::endl;
+    }
+}
+
+void SearchEngine::printSearchResults(SearchResultData result){
     // First get "background info"
-    uint64 totalNodes = 0;
+    uint64 nodeCount = totalNodes();
     TimePoint timeSpent = tm.timeSpent();
-    uint64 hashFull = globalTT.hashFullness();
+    uint64 hashFull = tt.hashFullness();
+    uint64 tbHits = 0;
 
-    for (int i = 0; i < threadCount; i++){
-        totalNodes += threadSD[i].nodes;
+    for (SearchData &sd : threadSD){
+        tbHits += sd.tbHits;
     }
 
-    // Now print out all info
-    std::cout << "info depth " << int(result.depthSearched);
-    std::cout << " seldepth " << int(result.selDepth);
-    
-    if (abs(result.score) >= FOUND_MATE){
-        std::cout << " score mate " << (CHECKMATE_SCORE - abs(result.score) + 1) * (result.score > 0 ? 1 : -1) / 2;
-    }
-    else{
-        std::cout << " score cp " << result.score;
-    }
-            
-    std::cout << " nodes " << totalNodes;
-    std::cout << " time " << timeSpent;
-    std::cout << " nps " << int(totalNodes / (timeSpent / 1000.0 + 0.00001));
-    std::cout << " hashfull " << hashFull;
-    std::cout << " pv ";
+    // Now print out all info (one info line for each PV line)
+    for (int i = 0; i < static_cast<int>(result.lines.size()); i++){
+        PVLine &line = result.lines[i];
+
+        std::ostringstream info;
+
+        info << "info depth " << int(result.depthSearched);
+        info << " seldepth " << int(line.selDepth);
 
-    for (std::string mv : result.pvMoves){
-        std::cout << mv << " ";
+        if (result.lines.size() > 1){
+            info << " multipv " << i + 1;
+        }
+        if (abs(line.score) >= FOUND_MATE){
+            info << " score mate " << (CHECKMATE_SCORE - abs(line.score) + 1) * (line.score > 0 ? 1 : -1) / 2;
+        }
+        else{
+            info << " score cp " << line.score;
+        }
+                
+        info << " nodes " << nodeCount;
+        info << " time " << timeSpent / 1000;
+        info << " nps " << static_cast<uint64>(nodeCount * 1000000.0 / (timeSpent + 1));
+        info << " hashfull " << hashFull;
+        info << " tbhits " << tbHits;
+        info << " pv ";
+
+        for (Move mv : line.pvMoves){
+            info << moveToString(mv) << " ";
+        }
+        print(info.str());
     }
-    std::cout << std::endl;
 }
 
-void selectBestThread(){
+void SearchEngine::selectBestThread(){
     // We use thread 0 to report info and keep track of time. However, it may not be the best
-    // thread so we should select the best thread, report its info, and report its best move
+    // thread so we let every thread vote for its best move. A vote is weighted by how much better
+    // the thread's score is than the worst score and by the depth the thread completed. The move
+    // with the most votes wins and we report the result of a thread that chose that move
+
+    // No legal moves (we are mated or stalemated)
+    if (threadSD[0].rootMoves.empty()){
+        print("bestmove 0000");
+        return;
+    }
+
+    // Stopped before the first iteration finished so there are no lines to report yet
+    if (threadSD[0].result.depthSearched == 0){
+        print("bestmove " + moveToString(threadSD[0].rootMoves[0].move));
+        return;
+    }
+
+    // With MultiPV we simply report the main thread's lines
 
     SearchResultData bestResult = threadSD[0].result;
+    Score minScore = bestResult.lines[0].score;
+    std::map<Move, int64> votes;
 
-    for (int i = 1; i < threadCount; i++){
-        SearchResultData otherResult = threadSD[i].result;
+    for (int i = 1; i < getThreadCount() and multiPV == 1; i++){
+        if (threadSD[i].result.depthSearched > 0){
+            minScore = std::min(minScore, threadSD[i].result.lines[0].score);
+        }
+    }
+    for (int i = 0; i < getThreadCount() and multiPV == 1; i++){
+        SearchResultData &result = threadSD[i].result;
 
-        // If both are mating scores, use which one is closer
-        if (abs(bestResult.score) >= FOUND_MATE and abs(otherResult.score) >= FOUND_MATE){
-            if (abs(otherResult.score) > abs(bestResult.score)){
-                bestResult = otherResult;
-            }
+        if (result.depthSearched > 0){
+            votes[result.lines[0].pvMoves[0]] += (static_cast<int64>(result.lines[0].score) - minScore + 14) * result.depthSearched;
         }
+    }
+    for (int i = 1; i < getThreadCount() and multiPV == 1; i++){
+        SearchResultData &otherResult = threadSD[i].result;
 
-        // If both have equal depth, use whichever one has the higher score
-        else if (bestResult.depthSearched == otherResult.depthSearched){
-            if (otherResult.score > bestResult.score){
-                bestResult = otherResult;
-            }
+        // Thread didn't finish a single depth
+        if (otherResult.depthSearched == 0){
+            continue;
         }
+        Score bestScore = bestResult.lines[0].score;
+        Score otherScore = otherResult.lines[0].score;
 
-        // Otherwise, use the one with the higher depth
-        else{
-            if (otherResult.depthSearched > bestResult.depthSearched){
+        // If we have a mating score, only switch to a closer mate
+        if (abs(bestScore) >= FOUND_MATE){
+            if (otherScore > bestScore){
                 bestResult = otherResult;
             }
         }
+
+        // Always take a mating score. Otherwise use whichever move has more votes (but never
+        // switch to a thread that thinks it is getting mated)
+        else if (otherScore >= FOUND_MATE
+                 or (otherScore > -FOUND_MATE and votes[otherResult.lines[0].pvMoves[0]] > votes[bestResult.lines[0].pvMoves[0]]))
+        {
+            bestResult = otherResult;
+        }
     }
     // Print the final result of the search
-    printSearchResults(bestResult);
-    std::cout << "bestmove " << bestResult.pvMoves[0];
+    std::vector<Move> &bestPV = bestResult.lines[0].pvMoves;
+    std::string bestmove = "bestmove " + moveToString(bestPV[0]);
 
-    if (bestResult.pvMoves.size() >= 2){
-        std::cout << " ponder " << bestResult.pvMoves[1];
+    if (bestPV.size() >= 2){
+        bestmove += " ponder " + moveToString(bestPV[1]);
     }
-    std::cout << std::endl;
+    printSearchResults(bestResult);
+    print(bestmove);
 }
 
 void iterativeDeepening(Position board, SearchData &sd, Depth depthLim){
-    Score score = NO_SCORE;
+    // Nothing to search if we are mated or stalemated
+    if (sd.rootMoves.empty()){
+        return;
+    }
+    
+    // We can't search more lines than there are root moves
+    int lineCount = std::min(sd.independent ? 1 : sd.engine->multiPV, static_cast<int>(sd.rootMoves.size()));
 
     for (Depth startingDepth = 1; startingDepth <= depthLim; startingDepth++){
-        // Search
+        // Helper threads skip depths according to their schedule so that they don't
+        // all duplicate the work of the main thread
+        if (sd.threadId > 0){
+            int idx = (sd.threadId - 1) % SMP_SKIP_TABLE_SIZE;
+
+            if (((startingDepth + SKIP_PHASE[idx]) / SKIP_SIZE[idx]) % 2){
+                continue;
+            }
+        }
+
+        // Save the results of the previous iteration
+        for (RootMove &rm : sd.rootMoves){
+            rm.prevScore = rm.score;
+        }
         sd.selDepth = 0;
-        score = aspirationWindowSearch(score, startingDepth, board, sd);
+
+        // Search each line (the root moves of the lines before it are excluded). Each line
+        // uses its score from the previous iteration for its aspiration window
+        for (sd.pvIdx = 0; sd.pvIdx < lineCount; sd.pvIdx++){
+            aspirationWindowSearch(sd.rootMoves[sd.pvIdx].prevScore, startingDepth, board, sd);
+
+            if (sd.stopped){
+                break;
+            }
+            // A later line may score higher than an earlier one due to search instability
+            std::stable_sort(sd.rootMoves.begin(), sd.rootMoves.begin() + sd.pvIdx + 1);
+        }
+        sd.pvIdx = 0;
 
         if (!sd.stopped){
             // Log search data
             sd.result.depthSearched = startingDepth;
-            sd.result.selDepth = sd.selDepth;
-            sd.result.score = score;
-            sd.result.pvMoves.clear();
+            sd.result.lines.clear();
 
-            for (Depth i = 0; i < sd.pvLength[0]; i++){
-                sd.result.pvMoves.push_back(moveToString(sd.pvTable[0][i]));
+            STATS_INC(sd, iterations[startingDepth]);
+            STATS_ADD(sd, iterationNodes[startingDepth], sd.nodes);
+
+            for (int i = 0; i < lineCount; i++){
+                RootMove &rm = sd.rootMoves[i];
+
+                // If the root is in the tablebases, report the tablebase score unless we found a mate
+                Score score = (!sd.independent and sd.engine->rootInTB and abs(rm.score) < FOUND_MATE) ? rm.tbScore : rm.score;
+                sd.result.lines.push_back({score, rm.selDepth, rm.pv});
+            }
+
+            if (sd.independent){
+                RootMove &best = sd.rootMoves[0];
+                sd.iterations.push_back({startingDepth, best.move, best.score, sd.nodes, getTime() - sd.independentStartTime});
             }
 
             // Print and update best move and timeman if we are in main thread
-            if (sd.threadId == 0){
-                printSearchResults(sd.result);
+            if (sd.threadId == 0 and !sd.independent){
+                SearchEngine &engine = *sd.engine;
+                engine.printSearchResults(sd.result);
 
-                Move bestMove = sd.pvTable[0][0];
-                tm.update(startingDepth, bestMove, score, 1.0 - (static_cast<double>(sd.moveNodeStat[moveFrom(bestMove)][moveTo(bestMove)]) / (sd.nodes + 1.0)));
+                RootMove &best = sd.rootMoves[0];
+                engine.tm.update(startingDepth, best.move, best.score);
 
                 // See if we should continue to next depth
-                if (tm.stopAfterSearch()){
+                if (!engine.pondering and engine.tm.stopAfterSearch(bestMoveNodeFraction(sd))){
                     break;
                 }
             }                
@@ -919,7 +1214,70 @@ void iterativeDeepening(Position board, SearchData &sd, Depth depthLim){
     }
 }
 
-void beginSearch(Position board, uciSearchLims lims){
+static void initRootMoves(Position &board, std::vector<Move> &searchMoves, SearchData &sd){
+    // All legal moves (or only the legal moves in "go searchmoves ..." if given)
+    moveList moves;
+    board.genAllMoves(false, moves);
+
+    sd.rootMoves.clear();
+
+    for (int i = 0; i < moves.sz; i++){
+        Move move = moves.moves[i].move;
+
+        if (searchMoves.empty() or std::find(searchMoves.begin(), searchMoves.end(), move) != searchMoves.end()){
+            sd.rootMoves.push_back({move, -CHECKMATE_SCORE, -CHECKMATE_SCORE, 0, 0, {move}, 0, 0});
+        }
+    }
+    // None of the search moves are legal so search everything
+    if (sd.rootMoves.empty() and !searchMoves.empty()){
+        std::vector<Move> noSearchMoves;
+        initRootMoves(board, noSearchMoves, sd);
+    }
+}
+
+static bool rankRootMovesTB(Position &board, SearchData &sd){
+    // If the root is in the tablebases, rank the root moves by DTZ (or WDL if the DTZ tables
+    // are missing) and only keep the moves that preserve the best result. Also sets the
+    // probing limits of the search
+
+    std::vector<RootMove> &rootMoves = sd.rootMoves;
+    bool rootInTB = false;
+    sd.tbCardinality = std::min(syzygyProbeLimit, tbLargest);
+    sd.tbProbeDepth = syzygyProbeDepth;
+    bool dtzAvailable = true;
+
+    // Positions with less pieces than the largest tables are probed at any depth
+    if (syzygyProbeLimit > tbLargest){
+        sd.tbProbeDepth = 0;
+    }
+    if (!rootMoves.empty() and countOnes(board.allPieces()) <= sd.tbCardinality and !board.getCastleRights()){
+        rootInTB = probeRootDTZ(board, rootMoves);
+
+        if (!rootInTB){
+            dtzAvailable = false;
+            rootInTB = probeRootWDL(board, rootMoves);
+        }
+    }
+    if (rootInTB){
+        std::stable_sort(rootMoves.begin(), rootMoves.end(), [](const RootMove &a, const RootMove &b){
+            return a.tbRank > b.tbRank;
+        });
+
+        int bestRank = rootMoves[0].tbRank;
+
+        rootMoves.erase(std::remove_if(rootMoves.begin(), rootMoves.end(), [bestRank](const RootMove &rm){
+            return rm.tbRank != bestRank;
+        }), rootMoves.end());
+
+        // DTZ already tells us how to make progress so only probe in search if we only have WDL and are winning
+        if (dtzAvailable or rootMoves[0].tbScore <= 0){
+            sd.tbCardinality = 0;
+        }
+    }
+    return rootInTB;
+}
+
+void SearchEngine::search(Position board, uciSearchLims lims){
     // Deal with node and depth limits (if no depth limit, force it to be MAX_PLY)
     // Remember that 0 means the limit has not been set
 
@@ -928,22 +1286,33 @@ void beginSearch(Position board, uciSearchLims lims){
     if (!lims.depthLim)
         lims.depthLim = MAX_PLY;
 
-    // Init
+    // Init (stopFlag is cleared by whoever starts the search so that a stop that comes in before
+    // the search thread gets here isn't lost)
     tm.init(board.getTurn(), lims);
-    resetAllSearchDataNonHistory();
+    resetNonHistory();
+
+    initRootMoves(board, lims.searchMoves, threadSD[0]);
+    rootInTB = rankRootMovesTB(board, threadSD[0]);
+
+    for (int i = 1; i < getThreadCount(); i++){
+        threadSD[i].rootMoves = threadSD[0].rootMoves;
+        threadSD[i].tbCardinality = threadSD[0].tbCardinality;
+        threadSD[i].tbProbeDepth = threadSD[0].tbProbeDepth;
+    }
 
-    // Launch threadCount - 1 helper threads (start our indexing from 1)
-    for (int i = 1; i < threadCount; i++){
+    // Launch getThreadCount() - 1 helper threads (start our indexing from 1)
+    for (int i = 1; i < getThreadCount(); i++){
         threads[i] = std::thread(iterativeDeepening, board, std::ref(threadSD[i]), lims.depthLim);
     }
 
-    // Launch main thread
+    // Launch main thread (the time it took is what the time manager sees)
     iterativeDeepening(board, threadSD[0], lims.depthLim);
+    timeSearched = tm.timeSpent();
     
     // Once our main thread is done, stop and join helper threads
-    endSearch();
+    stop();
 
-    for (int i = 1; i < threadCount; i++){
+    for (int i = 1; i < getThreadCount(); i++){
         threads[i].join();
     }
     
@@ -952,6 +1321,26 @@ void beginSearch(Position board, uciSearchLims lims){
 
     // Report and update
     selectBestThread();
-    globalTT.incrementAge();
-    decayAllSearchDataHistory();
-}
\ No newline at end of file
+    tt.incrementAge();
+    decayHistory();
+
+    // Ready for the next search
+    stopFlag.store(false, std::memory_order_relaxed);
+}
+
+void independentSearch(Position board, SearchData &sd, uint64 nodes, Depth depthLim, TimePoint timeLim){
+    // The caller owns sd and its TT. Like the engine threads, history is kept between searches and
+    // decayed. Independent searches don't probe the tablebases
+    sd.resetNonHistory(0);
+    sd.independent = true;
+    sd.independentNodeLim = nodes;
+    sd.independentTimeLim = timeLim;
+    sd.independentStartTime = getTime();
+
+    std::vector<Move> searchMoves;
+    initRootMoves(board, searchMoves, sd);
+    iterativeDeepening(board, sd, depthLim ? depthLim : MAX_PLY);
+
+    sd.tt->incrementAge();
+    sd.decayHistory();
+}
@@ -5,12 +5,17 @@
 #include "helpers.h"
 #include "types.h"
 #include "uci.h"
+#include "timecontrol.h"
+#include "stats.h"
 #include <cstring>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <functional>
 
-// Global pondering flag. Note that pondering is only ended after stop / ponderhit / quit
-// command so we should keep the logic seperate from endSearch
-
-extern bool pondering;
+struct SearchEngine;
 
 struct SearchStack{
     Score staticEval;
@@ -22,19 +27,80 @@ struct SearchStack{
     Movescore (*contHist)[14][64];
 };
 
+struct RootMove{
+    Move move;
+    Score score;
+    Score prevScore;
+    Depth selDepth;
+    uint64 nodes;
+    std::vector<Move> pv;
+
+    // Tablebase rank (higher is better) and score (only used if the root is in the tablebases)
+    int tbRank;
+    Score tbScore;
+
+    // Sort by score and fall back on the score of the previous iteration
+    inline bool operator<(const RootMove &other) const{
+        return score != other.score ? score > other.score : prevScore > other.prevScore;
+    }
+};
+
+struct PVLine{
+    Score score;
+    Depth selDepth;
+    std::vector<Move> pvMoves;
+};
+
 struct SearchResultData{
     Depth depthSearched;
-    Depth selDepth;
+
+    // One entry per MultiPV line sorted from best to worst (lines[0] is the best line)
+    std::vector<PVLine> lines;
+};
+
+// Summary of a finished iteration of an independent search
+struct IterationInfo{
+    Depth depth;
+    Move move;
     Score score;
-    std::vector<std::string> pvMoves; 
+    uint64 nodes;
+    TimePoint time;     // Since the start of the search
 };
 
 struct SearchData{
     int threadId;
     bool stopped;
 
+    // Engine that runs this thread (nullptr for independent searches) and the TT that it uses
+    // (the engine's TT unless the search is independent)
+    SearchEngine *engine = nullptr;
+    ttStruct *tt = nullptr;
+
+    // Persistent hash (nullptr if disabled)
+    ttStruct *persistentTT = nullptr;
+
+    // Tablebase settings of the current search. We only probe positions with at most tbCardinality
+    // pieces (and at least tbProbeDepth if there are exactly tbCardinality pieces)
+    int tbCardinality = 0;
+    Depth tbProbeDepth = 0;
+
+    // Independent searches (datagen and EPD workers) don't print, don't use the time manager, and only stop
+    // on their own node and time limits so that many of them can run at the same time with their own TTs
+    bool independent = false;
+    uint64 independentNodeLim = 0;
+    TimePoint independentTimeLim = 0;
+    TimePoint independentStartTime = 0;
+
+    // Every finished iteration of an independent search (lets the EPD runner see when the best move settled)
+    std::vector<IterationInfo> iterations;
+
     Depth selDepth;
     SearchResultData result;
+
+    // Root moves (sorted by the results of the last search) and the index of the MultiPV
+    // line currently being searched. Only root moves from pvIdx onwards are searched
+    std::vector<RootMove> rootMoves;
+    int pvIdx;
     
     Move pvTable[MAX_PLY + 5][MAX_PLY + 5];
     Depth pvLength[MAX_PLY + 5];
@@ -46,13 +112,20 @@ struct SearchData{
     Movescore contHist[2][14][64][14][64];
 
     uint64 nodes;
-    uint64 moveNodeStat[64][64];
+    uint64 tbHits;
+
+#ifdef USE_STATS
+    // Search statistics (not reset between searches so that bench can sum them up)
+    SearchStats stats;
+#endif
 
     inline void resetNonHistory(int id){
         threadId = id;
         stopped = false;
         selDepth = 0;
         result = {};
+        iterations.clear();
+        pvIdx = 0;
 
         memset(pvTable, 0, sizeof(pvTable));
         memset(pvLength, 0, sizeof(pvLength));
@@ -61,7 +134,13 @@ struct SearchData{
         memset(counter, 0, sizeof(counter));
 
         nodes = 0;
-        memset(moveNodeStat, 0, sizeof(moveNodeStat)); 
+        tbHits = 0;
+    }
+
+    inline RootMove &findRootMove(Move move){
+        return *std::find_if(rootMoves.begin(), rootMoves.end(), [move](const RootMove &rm){
+            return rm.move == move;
+        });
     }
 
     inline void decayHistory(){
@@ -93,15 +172,65 @@ struct SearchData{
     }
 };
 
+// A complete searcher: TT, thread pool, time manager, and the state of the current search. Engines
+// only share read-only data (NNUE weights, attack tables, tablebases) so several of them can search
+// at the same time in one process. The UCI loop uses globalEngine
+struct SearchEngine{
+    ttStruct tt;
+
+    // Persistent hash of deep entries (disabled if persistentSize is 0)
+    ttStruct persistentTT;
+    int persistentSize = 0;
+
+    // Set when the search should end (by the caller or by thread 0 once it runs out of time or nodes).
+    // Only thread 0 looks at the clock and node count and helper threads just read this flag. It is
+    // cleared at the end of every search and by whoever starts a search
+    std::atomic<bool> stopFlag = false;
+
+    // Set by "go ponder". Note that pondering is only ended after stop / ponderhit / quit
+    // command so we should keep the logic seperate from stop
+    std::atomic<bool> pondering = false;
+
+    timeMan tm;
+    uint64 nodeLim = 0;
+    bool rootInTB = false;
+
+    // Number of principal variations to search and report
+    int multiPV = 1;
+
+    // Time the main thread spent on the last search (before waiting for the end of pondering)
+    TimePoint timeSearched = 0;
+
+    // Receives every info and bestmove line (without a newline). Prints to stdout if empty
+    std::function<void(const std::string&)> output;
+
+    std::vector<std::thread> threads;
+    std::vector<SearchData> threadSD;
+
+    // Threads
+    void setThreadCount(int tds);
+    void setPersistentSize(int megabytes);
+    int getThreadCount();
+    void resetNonHistory();
+    void decayHistory();
+    void clearHistory();
+
+    // Search related
+    void stop();
+    void ponderHit();
+    uint64 totalNodes();
+    void search(Position board, uciSearchLims lims);
+
+    void print(const std::string &line);
+    void printSearchResults(SearchResultData result);
+    void selectBestThread();
+};
+
+// Engine of the UCI loop and the benchmarks
+extern SearchEngine globalEngine;
+
 // Init
 void initLMR();
-void setThreadCount(int tds);
-
-// Thread related
-void resetAllSearchDataNonHistory();
-void decayAllSearchDataHistory();
-void clearAllSearchDataHistory();
 
-// Search related
-void endSearch();
-void beginSearch(Position board, uciSearchLims lims);
\ No newline at end of file
+// Independent searches run on the calling thread with a caller owned SearchData and TT
+void independentSearch(Position board, SearchData &sd, uint64 nodes, Depth depthLim, TimePoint timeLim);
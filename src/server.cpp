@@ -0,0 +1,303 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <algorithm>
+#include "server.h"
+#include "board.h"
+#include "search.h"
+#include "uci.h"
+
+struct ServerRequest{
+    std::string id;
+    Position board;
+    uciSearchLims lims;
+};
+
+struct ServerState{
+    std::vector<std::unique_ptr<SearchEngine>> engines;
+
+    // Id of the request that every engine is searching (empty if it is idle)
+    std::vector<std::string> running;
+
+    std::deque<ServerRequest> queue;
+    bool closing = false;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+
+    // Lines of different engines must not be mixed
+    std::mutex outMutex;
+};
+
+static void printLine(ServerState &state, const std::string &line){
+    std::lock_guard<std::mutex> lock(state.outMutex);
+    std::cout << line << std::endl;
+}
+
+static void serverWorker(ServerState &state, int engineId){
+    SearchEngine &engine = *state.engines[engineId];
+
+    while (true){
+        ServerRequest request;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.wakeUp.wait(lock, [&state](){ return state.closing or !state.queue.empty(); });
+
+            if (state.queue.empty()){
+                return;
+            }
+            request = std::move(state.queue.front());
+            state.queue.pop_front();
+            state.running[engineId] = request.id;
+            engine.stopFlag = false;
+        }
+
+        engine.output = [&state, id = request.id](const std::string &line){
+            printLine(state, id + " " + line);
+        };
+        engine.search(request.board, request.lims);
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.running[engineId].clear();
+    }
+}
+
+static void stopRequest(ServerState &state, const std::string &id){
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    // Queued requests are dropped and running ones stop and report their best move
+    auto queued = std::find_if(state.queue.begin(), state.queue.end(), [&id](const ServerRequest &request){
+        return request.id == id;
+    });
+    if (queued != state.queue.end()){
+        state.queue.erase(queued);
+        printLine(state, id + " cancelled");
+        return;
+    }
+    for (size_t i = 0; i < state.engines.size(); i++){
+        if (state.running[i] == id){
+            state.engines[i]->stop();
+        }
+    }
+}
+
+static bool parsePosition(Position &board, std::istringstream &iss, std::string &error){
+    // Same as the UCI position command but every part of it is checked since the positions come from users
+    std::string token, fen;
+    iss >> token;
+
+    if (token == "startpos"){
+        fen = startPosFen;
+        iss >> token;
+    }
+    else if (token == "fen"){
+        std::vector<std::string> fields;
+
+        while (iss >> token and token != "moves"){
+            fields.push_back(token);
+        }
+        if (fields.size() < 4 or fields.size() > 6){
+            error = "bad fen";
+            return false;
+        }
+        // The clocks may be left out
+        fields.resize(6);
+        fields[4] = fields[4].empty() ? "0" : fields[4];
+        fields[5] = fields[5].empty() ? "1" : fields[5];
+
+        for (const std::string &field : fields){
+            fen += field + " ";
+        }
+    }
+    else{
+        error = "expected startpos or fen";
+        return false;
+    }
+    if (!iss.eof() and token != "moves"){
+        error = "expected moves";
+        return false;
+    }
+    if (!checkFen(fen, error)){
+        return false;
+    }
+    try{
+        board.readFen(fen);
+    }
+    catch (const std::exception &e){
+        error = "bad fen";
+        return false;
+    }
+
+    // The side that just moved can't be in check
+    Color them = !board.getTurn();
+    Bitboard us = 0;
+
+    for (Piece piece = PAWN; piece <= KING; piece++){
+        us |= board.pieceBitboard(piece, board.getTurn());
+    }
+    if (board.attackersTo(board.kingSq(them), board.allPieces()) & us){
+        error = "the side not to move is in check";
+        return false;
+    }
+
+    // Every move has to be legal. The position stack only holds a fifty move rule's worth of moves
+    int reversibleMoves = 0;
+
+    while (iss >> token){
+        moveList moves;
+        board.genAllMoves(false, moves);
+
+        Move move = NULL_OR_NO_MOVE;
+
+        for (int i = 0; i < moves.sz; i++){
+            if (moveToString(moves.moves[i].move) == token){
+                move = moves.moves[i].move;
+            }
+        }
+        if (move == NULL_OR_NO_MOVE){
+            error = "illegal move " + token;
+            return false;
+        }
+        bool fmr = board.moveCaptType(move) != NO_PIECE or board.movePieceType(move) == PAWN;
+        board.makeMove(move);
+
+        if (fmr){
+            board.resetStack();
+            reversibleMoves = 0;
+        }
+        else if (++reversibleMoves > 100){
+            error = "too many moves without a capture or pawn move";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseRequest(const std::string &line, ServerRequest &request, std::string &error){
+    // "<id> <position arguments> go <go arguments>"
+    std::istringstream iss(line);
+    std::string token, position, go;
+    bool foundGo = false;
+
+    iss >> request.id;
+
+    while (iss >> token){
+        if (!foundGo and token == "go"){
+            foundGo = true;
+        }
+        else{
+            (foundGo ? go : position) += token + " ";
+        }
+    }
+    if (!foundGo or position.empty()){
+        error = "expected \"<id> [startpos | fen <fen>] [moves ...] go [go arguments]\"";
+        return false;
+    }
+
+    std::istringstream positionStream(position);
+    std::istringstream goStream(go);
+
+    if (!parsePosition(request.board, positionStream, error)){
+        return false;
+    }
+    request.lims = parseGo(goStream);
+
+    // Nobody is going to send a ponderhit
+    request.lims.ponder = false;
+    return true;
+}
+
+void runServerCommand(std::istringstream &iss){
+    int engineCount = SERVER_ENGINES;
+    int threads = SERVER_THREADS;
+    int hash = SERVER_HASH;
+    std::string token;
+
+    while (iss >> token){
+        if (token == "engines"){
+            iss >> engineCount;
+        }
+        else if (token == "threads"){
+            iss >> threads;
+        }
+        else if (token == "hash"){
+            iss >> hash;
+        }
+    }
+    engineCount = std::max(engineCount, 1);
+    threads = std::max(threads, 1);
+
+    ServerState state;
+
+    for (int i = 0; i < engineCount; i++){
+        state.engines.push_back(std::make_unique<SearchEngine>());
+        state.engines[i]->tt.setSize(hash);
+        state.engines[i]->setThreadCount(threads);
+        state.engines[i]->clearHistory();
+    }
+    state.running.resize(engineCount);
+
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < engineCount; i++){
+        workers.emplace_back(serverWorker, std::ref(state), i);
+    }
+    printLine(state, "server ready with " + std::to_string(engineCount) + " engines of " + std::to_string(threads)
+                     + " threads and " + std::to_string(hash) + " MB hash");
+
+    std::string line;
+
+    while (std::getline(std::cin, line)){
+        std::istringstream lineStream(line);
+        std::string first;
+
+        if (!(lineStream >> first)){
+            continue;
+        }
+        if (first == "quit"){
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.queue.clear();
+
+            for (std::unique_ptr<SearchEngine> &engine : state.engines){
+                engine->stop();
+            }
+            break;
+        }
+        else if (first == "isready"){
+            printLine(state, "readyok");
+        }
+        else if (first == "stop"){
+            std::string id;
+            lineStream >> id;
+            stopRequest(state, id);
+        }
+        else{
+            ServerRequest request;
+            std::string error;
+
+            if (!parseRequest(line, request, error)){
+                printLine(state, first + " error " + error);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.queue.push_back(std::move(request));
+            state.wakeUp.notify_one();
+        }
+    }
+
+    // Let the workers finish what is left in the queue (nothing after quit)
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.closing = true;
+    }
+    state.wakeUp.notify_all();
+
+    for (std::thread &worker : workers){
+        worker.join();
+    }
+}
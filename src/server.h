@@ -0,0 +1,22 @@
+#pragma once
+
+#include <sstream>
+#include "types.h"
+
+// Default size of the engine pool
+const int SERVER_ENGINES = 4;
+const int SERVER_THREADS = 1;       // Threads of every engine
+const int SERVER_HASH = 16;         // TT size (MB) of every engine
+
+// Command: server [engines N] [threads N] [hash MB]
+// Analysis server that runs a pool of search engines in this process (every engine has its own TT,
+// threads, and time manager and they all share the NNUE weights, attack tables, and tablebases).
+// Requests are read from stdin, one per line:
+//   <id> [startpos | fen <fen>] [moves ...] go [go arguments]   queue a search (go arguments as in UCI)
+//   stop <id>                                                   stop or cancel the search of a request
+//   isready                                                     replies "readyok"
+//   quit                                                        stop everything and leave
+// Searches are handed to free engines in the order they arrived and every info and bestmove line is
+// prefixed by the id of its request. Requests with a bad FEN or an illegal move are answered with
+// "<id> error <reason>". At the end of the input we wait for the queued searches to finish
+void runServerCommand(std::istringstream &iss);
@@ -0,0 +1,68 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <algorithm>
+#include "stats.h"
+
+static void printCounter(std::string name, uint64 count, uint64 total, std::string of){
+    std::cout << std::left << std::setw(24) << name << std::right << std::setw(14) << count
+              << std::setw(9) << 100.0 * count / std::max(total, static_cast<uint64>(1)) << " % of " << of << std::endl;
+}
+
+void printSearchStats(const SearchStats &stats){
+    std::cout << std::fixed << std::setprecision(2);
+
+    // Step 1) Nodes and the TT
+    std::cout << "search stats" << std::endl;
+    printCounter("TT hits", stats.ttHits, stats.nodes, "nodes");
+    printCounter("TT cutoffs", stats.ttCutoffs, stats.nodes, "nodes");
+    printCounter("qsearch TT hits", stats.qsTTHits, stats.qsNodes, "qsearch nodes");
+
+    // Step 2) Node pruning
+    printCounter("reverse futility", stats.rfp, stats.nodes, "nodes");
+    printCounter("razoring", stats.razoring, stats.nodes, "nodes");
+    printCounter("null move tried", stats.nmpTried, stats.nodes, "nodes");
+    printCounter("null move cutoffs", stats.nmpCutoffs, stats.nmpTried, "tried");
+    printCounter("probcut tried", stats.probcutTried, stats.nodes, "nodes");
+    printCounter("probcut cutoffs", stats.probcutCutoffs, stats.probcutTried, "tried");
+
+    // Step 3) Move pruning
+    printCounter("move count pruning", stats.lmp, stats.movesConsidered, "moves");
+    printCounter("futility pruning", stats.futility, stats.movesConsidered, "moves");
+    printCounter("history pruning", stats.historyPruning, stats.movesConsidered, "moves");
+    printCounter("SEE pruning", stats.seePruning, stats.movesConsidered, "moves");
+
+    // Step 4) Extensions and reductions
+    printCounter("singular tried", stats.singularTried, stats.nodes, "nodes");
+    printCounter("singular extensions", stats.singularExtensions, stats.singularTried, "tried");
+    printCounter("double extensions", stats.doubleExtensions, stats.singularTried, "tried");
+    printCounter("multicut", stats.multicut, stats.singularTried, "tried");
+    printCounter("negative extensions", stats.negativeExtensions, stats.singularTried, "tried");
+    printCounter("LMR searches", stats.lmrTried, stats.movesConsidered, "moves");
+    printCounter("LMR re-searches", stats.lmrResearches, stats.lmrTried, "LMR searches");
+    printCounter("PVS re-searches", stats.pvsResearches, stats.movesConsidered, "moves");
+
+    // Step 5) Cutoffs (a well ordered search gets almost all of them from the first move)
+    printCounter("beta cutoffs", stats.cutoffs, stats.nodes, "nodes");
+    printCounter("first move cutoffs", stats.firstMoveCutoffs, stats.cutoffs, "cutoffs");
+
+    // Step 6) Average branching factor: nodes of an iteration relative to the nodes of the one before it
+    // (only for the depths that every search finished since the node counts are summed over searches)
+    std::cout << "depth | nodes | branching factor" << std::endl;
+
+    for (int depth = 1; depth <= MAX_PLY and stats.iterations[depth] and stats.iterations[depth] == stats.iterations[1]; depth++){
+        uint64 nodes = stats.iterationNodes[depth] - stats.iterationNodes[depth - 1];
+        uint64 prevNodes = stats.iterationNodes[depth - 1] - (depth >= 2 ? stats.iterationNodes[depth - 2] : 0);
+
+        std::cout << depth << " | " << nodes << " | ";
+
+        if (depth >= 2 and prevNodes){
+            std::cout << static_cast<double>(nodes) / prevNodes;
+        }
+        else{
+            std::cout << "-";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
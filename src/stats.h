@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.h"
+
+// Search statistics ("make STATS=yes"). Every thread counts how often the pruning, reduction, and extension
+// steps of the search trigger in its own SearchStats and bench prints them at the end. Normal builds don't
+// have the counters at all so the macros compile to nothing
+
+#ifdef USE_STATS
+#define STATS_INC(sd, counter) ((sd).stats.counter++)
+#define STATS_ADD(sd, counter, value) ((sd).stats.counter += (value))
+#else
+#define STATS_INC(sd, counter) ((void)0)
+#define STATS_ADD(sd, counter, value) ((void)0)
+#endif
+
+struct SearchStats{
+    // Nodes that probe the TT (negamax and qsearch), TT hits, and TT cutoffs in negamax
+    uint64 nodes;
+    uint64 ttHits;
+    uint64 ttCutoffs;
+    uint64 qsNodes;
+    uint64 qsTTHits;
+
+    // Node pruning in negamax
+    uint64 rfp;
+    uint64 razoring;
+    uint64 nmpTried;
+    uint64 nmpCutoffs;
+    uint64 probcutTried;
+    uint64 probcutCutoffs;
+
+    // Move pruning in negamax (out of the moves that reach quiet move pruning)
+    uint64 movesConsidered;
+    uint64 lmp;
+    uint64 futility;
+    uint64 historyPruning;
+    uint64 seePruning;
+
+    // Singular extension search and its outcomes
+    uint64 singularTried;
+    uint64 singularExtensions;
+    uint64 doubleExtensions;
+    uint64 multicut;
+    uint64 negativeExtensions;
+
+    // Reduced searches, re-searches after a reduced search fails high, and PVS re-searches with the full window
+    uint64 lmrTried;
+    uint64 lmrResearches;
+    uint64 pvsResearches;
+
+    // Beta cutoffs in the move loop of negamax and how many of them came from the first move
+    uint64 cutoffs;
+    uint64 firstMoveCutoffs;
+
+    // Node count at the end of every iteration (summed over all searches) for the branching factor
+    uint64 iterationNodes[MAX_PLY + 1];
+    uint64 iterations[MAX_PLY + 1];
+};
+
+// Prints every counter with its rate and the average branching factor of every depth
+void printSearchStats(const SearchStats &stats);
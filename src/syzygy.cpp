@@ -0,0 +1,1244 @@
+#include "syzygy.h"
+#include "tt.h"
+#include "attacks.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+int tbLargest = 0;
+
+// Maximum number of pieces supported and a DTZ bound that is larger than any DTZ in the tables
+const int TB_PIECES = 7;
+const int MAX_DTZ = 1 << 18;
+
+// Table flags (all of them are for DTZ tables except TB_FLAG_SINGLE_VALUE)
+const uint8 TB_FLAG_STM = 1;
+const uint8 TB_FLAG_MAPPED = 2;
+const uint8 TB_FLAG_WIN_PLIES = 4;
+const uint8 TB_FLAG_LOSS_PLIES = 8;
+const uint8 TB_FLAG_WIDE = 16;
+const uint8 TB_FLAG_SINGLE_VALUE = 128;
+
+// Magic numbers at the start of the files
+const uint8 WDL_MAGIC[4] = {0x71, 0xE8, 0x23, 0x5D};
+const uint8 DTZ_MAGIC[4] = {0xD7, 0x66, 0x0C, 0xA5};
+
+// Piece letters in file names (indexed by piece type)
+const std::string TB_PIECE_CHARS = " PNBRQK";
+
+enum TBType{
+    TB_WDL,
+    TB_DTZ
+};
+
+// Huffman symbol
+using Sym = uint16;
+
+// Indexing tables (see initIndexTables)
+static int mapPawns[64];
+static int mapB1H1H7[64];
+static int mapA1D1D4[64];
+static int mapKK[10][64];
+
+static int binomial[6][64];
+static int leadPawnIdx[6][64];
+static int leadPawnsSize[6][4];
+
+static std::string tbPaths;
+
+// Files are little endian except for the Huffman coded data which is big endian
+
+template<typename T> static inline T swapBytes(T val){
+    uint8 *c = reinterpret_cast<uint8*>(&val);
+    std::reverse(c, c + sizeof(T));
+    return val;
+}
+
+template<typename T> static inline T readLE(const uint8 *addr){
+    T val;
+    memcpy(&val, addr, sizeof(T));
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? val : swapBytes(val);
+}
+
+template<typename T> static inline T readBE(const uint8 *addr){
+    T val;
+    memcpy(&val, addr, sizeof(T));
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? swapBytes(val) : val;
+}
+
+// Low level indexing information for a table. A table file contains one of these per side to
+// move (only for WDL tables of non-symmetric material) and per leading pawn file (only if there
+// are pawns). They are filled when the file is mapped
+
+struct PairsData{
+    uint8 flags;
+    uint8 maxSymLen;             // Maximum length in bits of the Huffman symbols
+    uint8 minSymLen;             // Minimum length in bits of the Huffman symbols (or the value if single valued)
+    uint32 numBlocks;            // Number of blocks of compressed data
+    uint64 blockSize;            // Block size in bytes
+    uint64 span;                 // There is a sparse index entry every span values
+    uint8 *lowestSym;            // lowestSym[l] is the lowest symbol of length l (16 bit entries)
+    uint8 *btree;                // Left and right child symbols of each symbol (3 byte entries)
+    uint8 *blockLength;          // Number of values (minus one) in each block (16 bit entries)
+    uint32 blockLengthSize;
+    uint8 *sparseIndex;          // Block and offset within the block of every span'th value (6 byte entries)
+    uint64 sparseIndexSize;
+    uint8 *data;                 // Start of the Huffman coded data
+    std::vector<uint64> base64;  // base64[l - minSymLen] is the lowest symbol of length l padded to 64 bits
+    std::vector<uint8> symlen;   // Number of values (minus one) a symbol expands to
+    int pieces[TB_PIECES];       // Pieces in the order they are encoded (type | color << 3)
+    uint64 groupIdx[TB_PIECES + 1];
+    int groupLen[TB_PIECES + 1]; // Pieces that are encoded together (ex: KRvKN is [3, 1])
+    uint16 mapIdx[4];            // Offsets of the DTZ value maps for win, loss, cursed win, blessed loss
+};
+
+template<TBType type> struct TBTable{
+    static const int SIDES = (type == TB_WDL ? 2 : 1);
+
+    std::atomic<bool> ready{false};
+    void *baseAddress = nullptr;
+    uint64 mapping = 0;
+    uint8 *map = nullptr;
+
+    // Material keys with the pieces of the file name's first side as white (key) or black (key2)
+    TTKey key = 0;
+    TTKey key2 = 0;
+    int pieceCount = 0;
+    bool hasPawns = false;
+    bool hasUniquePieces = false;
+    uint8 pawnCount[2] = {0, 0};
+
+    PairsData items[SIDES][4];
+
+    inline PairsData *get(int stm, int file){
+        return &items[stm % SIDES][hasPawns ? file : 0];
+    }
+
+    ~TBTable();
+};
+
+struct TBEntry{
+    TBTable<TB_WDL> *wdl;
+    TBTable<TB_DTZ> *dtz;
+};
+
+static std::deque<TBTable<TB_WDL>> wdlTables;
+static std::deque<TBTable<TB_DTZ>> dtzTables;
+static std::unordered_map<TTKey, TBEntry> tbHash;
+
+static inline int offA1H8(int sq){
+    return getRank(sq) - getFile(sq);
+}
+
+static inline int edgeDistance(int file){
+    return std::min(file, 7 - file);
+}
+
+static inline bool pawnsComp(int sq1, int sq2){
+    return mapPawns[sq1] < mapPawns[sq2];
+}
+
+static inline int signOf(int val){
+    return (0 < val) - (val < 0);
+}
+
+static inline Sym symLeft(PairsData *d, Sym sym){
+    uint8 *lr = d->btree + 3 * sym;
+    return ((lr[1] & 0xF) << 8) | lr[0];
+}
+
+static inline Sym symRight(PairsData *d, Sym sym){
+    uint8 *lr = d->btree + 3 * sym;
+    return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+static TTKey materialKey(int counts[2][7]){
+    TTKey key = 0;
+
+    for (Color col : {WHITE, BLACK}){
+        for (Piece pieceType = PAWN; pieceType <= KING; pieceType++){
+            for (int i = 0; i < counts[col][pieceType]; i++){
+                key ^= ttRngPiece[pieceType][col][i];
+            }
+        }
+    }
+    return key;
+}
+
+static TTKey materialKey(Position &board){
+    int counts[2][7] = {};
+
+    for (Color col : {WHITE, BLACK}){
+        for (Piece pieceType = PAWN; pieceType <= KING; pieceType++){
+            counts[col][pieceType] = countOnes(board.pieceBitboard(pieceType, col));
+        }
+    }
+    return materialKey(counts);
+}
+
+static bool noLegalMoves(Position &board){
+    moveList moves;
+    board.genAllMoves(false, moves);
+    return moves.sz == 0;
+}
+
+static std::string findFile(std::string name){
+    // Return the full path of the file or an empty string if it doesn't exist
+#ifdef _WIN32
+    const char SEPERATOR = ';';
+#else
+    const char SEPERATOR = ':';
+#endif
+    std::istringstream iss(tbPaths);
+    std::string dir;
+
+    while (std::getline(iss, dir, SEPERATOR)){
+        std::string path = dir + "/" + name;
+
+        if (std::ifstream(path).is_open()){
+            return path;
+        }
+    }
+    return "";
+}
+
+static void unmapFile(void *baseAddress, uint64 mapping){
+#ifdef _WIN32
+    UnmapViewOfFile(baseAddress);
+    CloseHandle(reinterpret_cast<HANDLE>(mapping));
+#else
+    munmap(baseAddress, mapping);
+#endif
+}
+
+template<TBType type> TBTable<type>::~TBTable(){
+    if (baseAddress){
+        unmapFile(baseAddress, mapping);
+    }
+}
+
+static uint8 *mapFile(std::string name, TBType type, void *&baseAddress, uint64 &mapping){
+    // Memory map the file and return a pointer to the data after the magic number (nullptr if we fail)
+    std::string path = findFile(name);
+    baseAddress = nullptr;
+
+    if (path.empty()){
+        return nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+    if (fd == INVALID_HANDLE_VALUE){
+        return nullptr;
+    }
+    DWORD sizeHigh;
+    DWORD sizeLow = GetFileSize(fd, &sizeHigh);
+
+    if (sizeLow % 64 != 16){
+        std::cout << "info string Corrupt tablebase file " << path << std::endl;
+        CloseHandle(fd);
+        return nullptr;
+    }
+    HANDLE mmapHandle = CreateFileMapping(fd, nullptr, PAGE_READONLY, sizeHigh, sizeLow, nullptr);
+    CloseHandle(fd);
+
+    if (!mmapHandle){
+        return nullptr;
+    }
+    mapping = reinterpret_cast<uint64>(mmapHandle);
+    baseAddress = MapViewOfFile(mmapHandle, FILE_MAP_READ, 0, 0, 0);
+
+    if (!baseAddress){
+        CloseHandle(mmapHandle);
+        return nullptr;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd == -1){
+        return nullptr;
+    }
+    struct stat statbuf;
+    fstat(fd, &statbuf);
+
+    // Every file is a multiple of 64 bytes plus the 16 byte checksum
+    if (statbuf.st_size % 64 != 16){
+        std::cout << "info string Corrupt tablebase file " << path << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    mapping = statbuf.st_size;
+    baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (baseAddress == MAP_FAILED){
+        baseAddress = nullptr;
+        return nullptr;
+    }
+#ifdef MADV_RANDOM
+    madvise(baseAddress, statbuf.st_size, MADV_RANDOM);
+#endif
+#endif
+
+    uint8 *data = static_cast<uint8*>(baseAddress);
+
+    if (memcmp(data, type == TB_WDL ? WDL_MAGIC : DTZ_MAGIC, 4)){
+        std::cout << "info string Corrupt tablebase file " << path << std::endl;
+        unmapFile(baseAddress, mapping);
+        baseAddress = nullptr;
+        return nullptr;
+    }
+    return data + 4;
+}
+
+static int decompressPairs(PairsData *d, uint64 idx){
+    // The values are compressed with Recursive Pairing (every symbol represents a pair of symbols)
+    // and the symbols are Huffman coded into blocks. Each block stores blockLength + 1 values and
+    // the sparse index tells us where every span'th value is so we don't have to scan every block
+
+    if (d->flags & TB_FLAG_SINGLE_VALUE){
+        return d->minSymLen;
+    }
+
+    // Step 1) Find the block and the offset of our value in the block
+    // Sparse index entry k describes value k * span + span / 2 so we start from the closest entry
+
+    uint32 k = idx / d->span;
+    uint32 block = readLE<uint32>(d->sparseIndex + 6 * k);
+    int offset = readLE<uint16>(d->sparseIndex + 6 * k + 4);
+
+    offset += static_cast<int>(idx % d->span) - static_cast<int>(d->span / 2);
+
+    while (offset < 0){
+        offset += readLE<uint16>(d->blockLength + 2 * (--block)) + 1;
+    }
+    while (offset > readLE<uint16>(d->blockLength + 2 * block)){
+        offset -= readLE<uint16>(d->blockLength + 2 * (block++)) + 1;
+    }
+
+    // Step 2) Read symbols until we get to the symbol that contains our offset
+    // All symbols of the same length are consecutive so we can get a symbol's length from base64
+
+    uint8 *ptr = d->data + block * d->blockSize;
+    uint64 buf64 = readBE<uint64>(ptr);
+    int buf64Size = 64;
+    Sym sym;
+
+    ptr += 8;
+
+    while (true){
+        int len = 0;
+
+        while (buf64 < d->base64[len]){
+            len++;
+        }
+        sym = ((buf64 - d->base64[len]) >> (64 - len - d->minSymLen)) + readLE<Sym>(d->lowestSym + 2 * len);
+
+        if (offset < d->symlen[sym] + 1){
+            break;
+        }
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+
+        // Refill the buffer
+        if (buf64Size <= 32){
+            buf64Size += 32;
+            buf64 |= static_cast<uint64>(readBE<uint32>(ptr)) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+
+    // Step 3) Expand the symbol into its pair of symbols until we reach a leaf
+
+    while (d->symlen[sym]){
+        Sym left = symLeft(d, sym);
+
+        if (offset < d->symlen[left] + 1){
+            sym = left;
+        }
+        else{
+            offset -= d->symlen[left] + 1;
+            sym = symRight(d, sym);
+        }
+    }
+    return symLeft(d, sym);
+}
+
+template<TBType type> static bool checkDTZStm(TBTable<type> *entry, int stm, int file){
+    // DTZ tables only store one side to move (unless the material is symmetric with no pawns)
+    if (type == TB_WDL){
+        return true;
+    }
+    uint8 flags = entry->get(stm, file)->flags;
+    return (flags & TB_FLAG_STM) == stm or (entry->key == entry->key2 and !entry->hasPawns);
+}
+
+template<TBType type> static int mapScore(TBTable<type> *entry, int file, int value, int wdl){
+    // WDL tables store wdl + 2. DTZ tables store the values of each result sorted by frequency
+    // so we need to map them back (and convert moves to plies)
+
+    if (type == TB_WDL){
+        return value - 2;
+    }
+    const int WDL_MAP[5] = {1, 3, 0, 2, 0};
+
+    PairsData *d = entry->get(0, file);
+
+    if (d->flags & TB_FLAG_MAPPED){
+        int idx = d->mapIdx[WDL_MAP[wdl + 2]] + value;
+        value = (d->flags & TB_FLAG_WIDE) ? readLE<uint16>(entry->map + 2 * idx) : entry->map[idx];
+    }
+    if ((wdl == WDL_WIN and !(d->flags & TB_FLAG_WIN_PLIES))
+        or (wdl == WDL_LOSS and !(d->flags & TB_FLAG_LOSS_PLIES))
+        or wdl == WDL_CURSED_WIN
+        or wdl == WDL_BLESSED_LOSS)
+    {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+template<TBType type> static int doProbeTable(Position &board, TBTable<type> *entry, int wdl, ProbeState &result){
+    // Compute the index of the position in the table and decompress the value at the index.
+    // Pieces of a group (same type and color) are encoded with binomial coefficients:
+    // idx = binomial[1][s1] + binomial[2][s2] + ... + binomial[k][sk] where s1 < s2 < ... < sk
+
+    int squares[TB_PIECES];
+    int pieces[TB_PIECES];
+    int size = 0;
+    int leadPawnsCnt = 0;
+    int tbFile = FILE_A;
+    uint64 idx;
+    Bitboard leadPawns = 0;
+
+    // Step 1) Flip colors if needed
+    // Tables are stored with the first side of the file name as white. If the material is
+    // symmetric, only white to move is stored
+
+    bool symmetricBlackToMove = (entry->key == entry->key2 and board.getTurn() == BLACK);
+    bool blackStronger = (materialKey(board) != entry->key);
+    bool flipped = symmetricBlackToMove or blackStronger;
+
+    int flipColor = flipped * 8;
+    int flipSquares = flipped * 56;
+    int stm = flipped ^ board.getTurn();
+
+    // Step 2) Leading pawns
+    // With pawns, the table is split by the file of the leading pawn (the pawn with the highest
+    // mapPawns value) mirrored to files a...d
+
+    if (entry->hasPawns){
+        int pc = entry->get(0, 0)->pieces[0] ^ flipColor;
+
+        for (Bitboard b = leadPawns = board.pieceBitboard(PAWN, pc >> 3); b;){
+            squares[size++] = poplsb(b) ^ flipSquares;
+        }
+        leadPawnsCnt = size;
+
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCnt, pawnsComp));
+        tbFile = edgeDistance(getFile(squares[0]));
+    }
+
+    if (!checkDTZStm(entry, stm, tbFile)){
+        result = PROBE_CHANGE_STM;
+        return 0;
+    }
+
+    // Step 3) Add the remaining pieces and reorder them to match the order in the table
+
+    for (Bitboard b = board.allPieces() ^ leadPawns; b;){
+        Square sq = poplsb(b);
+        Piece enc = board.pieceAt(sq);
+
+        squares[size] = sq ^ flipSquares;
+        pieces[size++] = (getPieceType(enc) | (getPieceColor(enc) << 3)) ^ flipColor;
+    }
+
+    PairsData *d = entry->get(stm, tbFile);
+
+    for (int i = leadPawnsCnt; i < size - 1; i++){
+        for (int j = i + 1; j < size; j++){
+            if (d->pieces[i] == pieces[j]){
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    // Step 4) Encode the leading group
+    // Mirror so that the leading piece is on files a...d
+
+    if (getFile(squares[0]) > FILE_D){
+        for (int i = 0; i < size; i++){
+            squares[i] ^= 7;
+        }
+    }
+
+    if (entry->hasPawns){
+        idx = leadPawnIdx[leadPawnsCnt][squares[0]];
+
+        std::stable_sort(squares + 1, squares + leadPawnsCnt, pawnsComp);
+
+        for (int i = 1; i < leadPawnsCnt; i++){
+            idx += binomial[i][mapPawns[squares[i]]];
+        }
+    }
+    else{
+        // Without pawns we can also mirror so that the leading piece is in the a1-d1-d4 triangle
+        if (getRank(squares[0]) > RANK_4){
+            for (int i = 0; i < size; i++){
+                squares[i] ^= 56;
+            }
+        }
+        // Mirror along the a1-h8 diagonal so the first piece off the diagonal is below it
+        for (int i = 0; i < d->groupLen[0]; i++){
+            if (!offA1H8(squares[i])){
+                continue;
+            }
+            if (offA1H8(squares[i]) > 0){
+                for (int j = i; j < size; j++){
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                }
+            }
+            break;
+        }
+
+        // If there are unique pieces, the leading group is 3 pieces. Otherwise it's the 2 kings
+        if (entry->hasUniquePieces){
+            int adjust1 = (squares[1] > squares[0]);
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+            // First piece below the diagonal
+            if (offA1H8(squares[0])){
+                idx = (mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            }
+            // First piece on the diagonal, second below
+            else if (offA1H8(squares[1])){
+                idx = (6 * 63 + getRank(squares[0]) * 28 + mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            }
+            // First two pieces on the diagonal, third below
+            else if (offA1H8(squares[2])){
+                idx = 6 * 63 * 62 + 4 * 28 * 62
+                    + getRank(squares[0]) * 7 * 28
+                    + (getRank(squares[1]) - adjust1) * 28
+                    + mapB1H1H7[squares[2]];
+            }
+            // All three pieces on the diagonal
+            else{
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+                    + getRank(squares[0]) * 7 * 6
+                    + (getRank(squares[1]) - adjust1) * 6
+                    + (getRank(squares[2]) - adjust2);
+            }
+        }
+        else{
+            idx = mapKK[mapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    // Step 5) Encode the remaining groups
+    // Squares are mapped down to skip squares taken by pieces of the previous groups
+
+    idx *= d->groupIdx[0];
+    int *groupSq = squares + d->groupLen[0];
+    bool remainingPawns = entry->hasPawns and entry->pawnCount[1];
+
+    for (int next = 1; d->groupLen[next]; next++){
+        std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+        uint64 n = 0;
+
+        for (int i = 0; i < d->groupLen[next]; i++){
+            int adjust = std::count_if(squares, groupSq, [&](int sq){
+                return groupSq[i] > sq;
+            });
+            n += binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+
+    return mapScore(entry, tbFile, decompressPairs(d, idx), wdl);
+}
+
+template<TBType type> static void setGroups(TBTable<type> &e, PairsData *d, int order[2], int file){
+    // Group the pieces that are encoded together (pieces of the same type and color). The leading
+    // group is the pawns of one side, 3 unique pieces, or the 2 kings. The groups are encoded as
+    // g1 * N(g2) * N(g3) + g2 * N(g3) + g3 in the order given by the table
+
+    int n = 0;
+    int firstLen = e.hasPawns ? 0 : (e.hasUniquePieces ? 3 : 2);
+    d->groupLen[n] = 1;
+
+    for (int i = 1; i < e.pieceCount; i++){
+        if (--firstLen > 0 or d->pieces[i] == d->pieces[i - 1]){
+            d->groupLen[n]++;
+        }
+        else{
+            d->groupLen[++n] = 1;
+        }
+    }
+    d->groupLen[++n] = 0;
+
+    bool pp = e.hasPawns and e.pawnCount[1];
+    int next = pp ? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+    uint64 idx = 1;
+
+    for (int k = 0; next < n or k == order[0] or k == order[1]; k++){
+        // Leading pawns or pieces
+        if (k == order[0]){
+            d->groupIdx[0] = idx;
+            idx *= e.hasPawns ? leadPawnsSize[d->groupLen[0]][file] : (e.hasUniquePieces ? 31332 : 462);
+        }
+        // Remaining pawns
+        else if (k == order[1]){
+            d->groupIdx[1] = idx;
+            idx *= binomial[d->groupLen[1]][48 - d->groupLen[0]];
+        }
+        // Remaining pieces
+        else{
+            d->groupIdx[next] = idx;
+            idx *= binomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next++];
+        }
+    }
+    d->groupIdx[n] = idx;
+}
+
+static uint8 setSymlen(PairsData *d, Sym sym, std::vector<bool> &visited){
+    // Number of values (minus one) a symbol expands to
+    visited[sym] = true;
+    Sym right = symRight(d, sym);
+
+    if (right == 0xFFF){
+        return 0;
+    }
+    Sym left = symLeft(d, sym);
+
+    if (!visited[left]){
+        d->symlen[left] = setSymlen(d, left, visited);
+    }
+    if (!visited[right]){
+        d->symlen[right] = setSymlen(d, right, visited);
+    }
+    return d->symlen[left] + d->symlen[right] + 1;
+}
+
+static uint8 *setSizes(PairsData *d, uint8 *data){
+    d->flags = *data++;
+
+    if (d->flags & TB_FLAG_SINGLE_VALUE){
+        d->numBlocks = d->blockLengthSize = 0;
+        d->span = d->sparseIndexSize = 0;
+        d->minSymLen = *data++;
+        return data;
+    }
+
+    // The last group index is the size of the table
+    uint64 tbSize = d->groupIdx[std::find(d->groupLen, d->groupLen + TB_PIECES, 0) - d->groupLen];
+
+    d->blockSize = 1ULL << *data++;
+    d->span = 1ULL << *data++;
+    d->sparseIndexSize = (tbSize + d->span - 1) / d->span;
+    uint8 padding = *data++;
+    d->numBlocks = readLE<uint32>(data);
+    data += 4;
+    d->blockLengthSize = d->numBlocks + padding;
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    d->lowestSym = data;
+    d->base64.resize(d->maxSymLen - d->minSymLen + 1);
+
+    // Canonical Huffman code: longer symbols have lower values so base64[i] >= base64[i + 1]
+    for (int i = static_cast<int>(d->base64.size()) - 2; i >= 0; i--){
+        d->base64[i] = (d->base64[i + 1] + readLE<Sym>(d->lowestSym + 2 * i) - readLE<Sym>(d->lowestSym + 2 * (i + 1))) / 2;
+    }
+    for (int i = 0; i < static_cast<int>(d->base64.size()); i++){
+        d->base64[i] <<= 64 - i - d->minSymLen;
+    }
+    data += d->base64.size() * sizeof(Sym);
+
+    d->symlen.resize(readLE<uint16>(data));
+    data += 2;
+    d->btree = data;
+
+    std::vector<bool> visited(d->symlen.size());
+
+    for (Sym sym = 0; sym < d->symlen.size(); sym++){
+        if (!visited[sym]){
+            d->symlen[sym] = setSymlen(d, sym, visited);
+        }
+    }
+    return data + d->symlen.size() * 3 + (d->symlen.size() & 1);
+}
+
+template<TBType type> static uint8 *setDTZMap(TBTable<type> &e, uint8 *data, int maxFile){
+    if (type == TB_WDL){
+        return data;
+    }
+    e.map = data;
+
+    for (int f = FILE_A; f <= maxFile; f++){
+        PairsData *d = e.get(0, f);
+
+        if (!(d->flags & TB_FLAG_MAPPED)){
+            continue;
+        }
+        if (d->flags & TB_FLAG_WIDE){
+            data += reinterpret_cast<uintptr_t>(data) & 1;
+
+            for (int i = 0; i < 4; i++){
+                d->mapIdx[i] = (data - e.map) / 2 + 1;
+                data += 2 * readLE<uint16>(data) + 2;
+            }
+        }
+        else{
+            for (int i = 0; i < 4; i++){
+                d->mapIdx[i] = data - e.map + 1;
+                data += *data + 1;
+            }
+        }
+    }
+    return data + (reinterpret_cast<uintptr_t>(data) & 1);
+}
+
+template<TBType type> static void setTable(TBTable<type> &e, uint8 *data){
+    // Fill the PairsData of a table from its just mapped file
+
+    // Skip the flags byte (split and has pawns)
+    data++;
+
+    const int sides = (TBTable<type>::SIDES == 2 and e.key != e.key2) ? 2 : 1;
+    const int maxFile = e.hasPawns ? FILE_D : FILE_A;
+    bool pp = e.hasPawns and e.pawnCount[1];
+
+    for (int f = FILE_A; f <= maxFile; f++){
+        for (int i = 0; i < sides; i++){
+            *e.get(i, f) = PairsData();
+        }
+        int order[2][2] = {{*data & 0xF, pp ? *(data + 1) & 0xF : 0xF},
+                           {*data >> 4, pp ? *(data + 1) >> 4 : 0xF}};
+        data += 1 + pp;
+
+        for (int k = 0; k < e.pieceCount; k++, data++){
+            for (int i = 0; i < sides; i++){
+                e.get(i, f)->pieces[k] = i ? (*data >> 4) : (*data & 0xF);
+            }
+        }
+        for (int i = 0; i < sides; i++){
+            setGroups(e, e.get(i, f), order[i], f);
+        }
+    }
+    data += reinterpret_cast<uintptr_t>(data) & 1;
+
+    for (int f = FILE_A; f <= maxFile; f++){
+        for (int i = 0; i < sides; i++){
+            data = setSizes(e.get(i, f), data);
+        }
+    }
+    data = setDTZMap(e, data, maxFile);
+
+    for (int f = FILE_A; f <= maxFile; f++){
+        for (int i = 0; i < sides; i++){
+            e.get(i, f)->sparseIndex = data;
+            data += e.get(i, f)->sparseIndexSize * 6;
+        }
+    }
+    for (int f = FILE_A; f <= maxFile; f++){
+        for (int i = 0; i < sides; i++){
+            e.get(i, f)->blockLength = data;
+            data += e.get(i, f)->blockLengthSize * 2;
+        }
+    }
+    for (int f = FILE_A; f <= maxFile; f++){
+        for (int i = 0; i < sides; i++){
+            // Compressed data is 64 byte aligned
+            data = reinterpret_cast<uint8*>((reinterpret_cast<uintptr_t>(data) + 0x3F) & ~static_cast<uintptr_t>(0x3F));
+            e.get(i, f)->data = data;
+            data += e.get(i, f)->numBlocks * e.get(i, f)->blockSize;
+        }
+    }
+}
+
+template<TBType type> static bool mapped(TBTable<type> &e, Position &board){
+    // Map the file the first time the table is probed (thread safe)
+    static std::mutex mappingMutex;
+
+    if (e.ready.load(std::memory_order_acquire)){
+        return e.baseAddress != nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mappingMutex);
+
+    if (e.ready.load(std::memory_order_relaxed)){
+        return e.baseAddress != nullptr;
+    }
+
+    // File name has the pieces of each side in decreasing order (ex: KRPvKR)
+    std::string w, b;
+
+    for (Piece pieceType = KING; pieceType >= PAWN; pieceType--){
+        w += std::string(countOnes(board.pieceBitboard(pieceType, WHITE)), TB_PIECE_CHARS[pieceType]);
+        b += std::string(countOnes(board.pieceBitboard(pieceType, BLACK)), TB_PIECE_CHARS[pieceType]);
+    }
+    std::string name = (e.key == materialKey(board) ? w + 'v' + b : b + 'v' + w) + (type == TB_WDL ? ".rtbw" : ".rtbz");
+    uint8 *data = mapFile(name, type, e.baseAddress, e.mapping);
+
+    if (data){
+        setTable(e, data);
+    }
+    e.ready.store(true, std::memory_order_release);
+    return e.baseAddress != nullptr;
+}
+
+template<TBType type> static int probeTable(Position &board, ProbeState &result, int wdl = WDL_DRAW){
+    // KvK
+    if (countOnes(board.allPieces()) == 2){
+        return WDL_DRAW;
+    }
+    auto it = tbHash.find(materialKey(board));
+
+    if (it == tbHash.end()){
+        result = PROBE_FAIL;
+        return 0;
+    }
+    TBTable<type> *entry;
+
+    if constexpr (type == TB_WDL){
+        entry = it->second.wdl;
+    }
+    else{
+        entry = it->second.dtz;
+    }
+    if (!mapped(*entry, board)){
+        result = PROBE_FAIL;
+        return 0;
+    }
+    return doProbeTable(board, entry, wdl, result);
+}
+
+static int tbSearch(Position &board, ProbeState &result, bool checkZeroingMoves){
+    // Tables don't store the correct value of positions where a capture (or a pawn move for DTZ)
+    // is the best move or where we have en passant. So we search the captures and take the best
+    // of their results and the stored value
+
+    moveList moves;
+    board.genAllMoves(false, moves);
+
+    int value, bestValue = WDL_LOSS;
+    int moveCount = 0;
+
+    for (int i = 0; i < moves.sz; i++){
+        Move move = moves.moves[i].move;
+
+        if (board.moveCaptType(move) == NO_PIECE and (!checkZeroingMoves or board.movePieceType(move) != PAWN)){
+            continue;
+        }
+        moveCount++;
+
+        board.makeMove(move);
+        value = -tbSearch(board, result, false);
+        board.undoLastMove();
+
+        if (result == PROBE_FAIL){
+            return WDL_DRAW;
+        }
+        if (value > bestValue){
+            bestValue = value;
+
+            if (value >= WDL_WIN){
+                result = PROBE_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // If we searched every legal move, the stored value may be wrong (ex: en passant)
+    bool noMoreMoves = (moveCount and moveCount == moves.sz);
+
+    if (noMoreMoves){
+        value = bestValue;
+    }
+    else{
+        value = probeTable<TB_WDL>(board, result);
+
+        if (result == PROBE_FAIL){
+            return WDL_DRAW;
+        }
+    }
+    if (bestValue >= value){
+        result = (bestValue > WDL_DRAW or noMoreMoves) ? PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+        return bestValue;
+    }
+    result = PROBE_OK;
+    return value;
+}
+
+static inline int dtzBeforeZeroing(int wdl){
+    // DTZ of the move before a zeroing move given the WDL after it
+    return wdl == WDL_WIN ? 1
+         : wdl == WDL_CURSED_WIN ? 101
+         : wdl == WDL_BLESSED_LOSS ? -101
+         : wdl == WDL_LOSS ? -1 : 0;
+}
+
+int probeWDL(Position &board, ProbeState &result){
+    result = PROBE_OK;
+    return tbSearch(board, result, false);
+}
+
+int probeDTZ(Position &board, ProbeState &result){
+    // Returns the DTZ in plies (negative if we lose). Values beyond -100 or 100 are cursed wins
+    // or blessed losses. The result can be off by one ply (ex: 2 can mean a win in 3 plies)
+
+    result = PROBE_OK;
+    int wdl = tbSearch(board, result, true);
+
+    // DTZ tables don't store draws
+    if (result == PROBE_FAIL or wdl == WDL_DRAW){
+        return 0;
+    }
+    // Best move is zeroing so the stored value is a "don't care" value
+    if (result == PROBE_ZEROING_BEST_MOVE){
+        return dtzBeforeZeroing(wdl);
+    }
+    int dtz = probeTable<TB_DTZ>(board, result, wdl);
+
+    if (result == PROBE_FAIL){
+        return 0;
+    }
+    if (result != PROBE_CHANGE_STM){
+        return (dtz + 100 * (wdl == WDL_BLESSED_LOSS or wdl == WDL_CURSED_WIN)) * signOf(wdl);
+    }
+
+    // The table stores the other side to move so do a 1 ply search for the best DTZ
+    moveList moves;
+    board.genAllMoves(false, moves);
+
+    int minDTZ = 0xFFFF;
+
+    for (int i = 0; i < moves.sz; i++){
+        Move move = moves.moves[i].move;
+        bool zeroing = board.moveCaptType(move) != NO_PIECE or board.movePieceType(move) == PAWN;
+
+        board.makeMove(move);
+
+        // For zeroing moves we want the DTZ before the move
+        dtz = zeroing ? -dtzBeforeZeroing(tbSearch(board, result, false)) : -probeDTZ(board, result);
+
+        // Mating move
+        if (dtz == 1 and board.inCheck() and noLegalMoves(board)){
+            minDTZ = 1;
+        }
+        if (!zeroing){
+            dtz += signOf(dtz);
+        }
+        if (dtz < minDTZ and signOf(dtz) == signOf(wdl)){
+            minDTZ = dtz;
+        }
+        board.undoLastMove();
+
+        if (result == PROBE_FAIL){
+            return 0;
+        }
+    }
+    // No legal moves means we are mated
+    return minDTZ == 0xFFFF ? -1 : minDTZ;
+}
+
+bool probeRootDTZ(Position &board, std::vector<RootMove> &rootMoves){
+    // Rank each root move by its DTZ. Wins that are safe from the fifty move rule are ranked
+    // equally and so are losses unless we can reach a draw by the fifty move rule
+
+    ProbeState result = PROBE_OK;
+    int cnt50 = board.getHalfMoveClock();
+    bool rep = board.hasRepeated();
+    int bound = MAX_DTZ / 2 - 100;
+
+    for (RootMove &rm : rootMoves){
+        int dtz;
+        board.makeMove(rm.move);
+
+        // Zeroing move so DTZ is one of -101, -1, 0, 1, 101
+        if (board.getHalfMoveClock() == 0){
+            dtz = dtzBeforeZeroing(-probeWDL(board, result));
+        }
+        // Draw by threefold repetition or the fifty move rule
+        else if (board.drawByRepetition(1) or board.drawByFiftyMoveRule()){
+            dtz = 0;
+        }
+        else{
+            dtz = -probeDTZ(board, result);
+            dtz = dtz > 0 ? dtz + 1 : (dtz < 0 ? dtz - 1 : dtz);
+        }
+        // Mating move
+        if (dtz == 2 and board.inCheck() and noLegalMoves(board)){
+            dtz = 1;
+        }
+        board.undoLastMove();
+
+        if (result == PROBE_FAIL){
+            return false;
+        }
+        int r = dtz > 0 ? (dtz + cnt50 <= 99 and !rep ? MAX_DTZ : MAX_DTZ / 2 - (dtz + cnt50))
+              : dtz < 0 ? (-dtz * 2 + cnt50 < 100 ? -MAX_DTZ : -MAX_DTZ / 2 + (-dtz + cnt50))
+              : 0;
+        rm.tbRank = r;
+
+        // Cursed wins get at least 1 cp and up to 49 cp as they get closer to a real win
+        rm.tbScore = r >= bound ? TB_WIN_SCORE
+                   : r > 0 ? (std::max(3, r - (MAX_DTZ / 2 - 200)) * PIECE_SCORE[PAWN]) / 200
+                   : r == 0 ? 0
+                   : r > -bound ? (std::min(-3, r + (MAX_DTZ / 2 - 200)) * PIECE_SCORE[PAWN]) / 200
+                   : -TB_WIN_SCORE;
+    }
+    return true;
+}
+
+bool probeRootWDL(Position &board, std::vector<RootMove> &rootMoves){
+    // Rank each root move by its WDL (used when the DTZ tables are missing)
+
+    const int WDL_TO_RANK[5] = {-MAX_DTZ, -MAX_DTZ + 101, 0, MAX_DTZ - 101, MAX_DTZ};
+    const Score WDL_TO_SCORE[5] = {-TB_WIN_SCORE, -2, 0, 2, TB_WIN_SCORE};
+
+    ProbeState result = PROBE_OK;
+
+    for (RootMove &rm : rootMoves){
+        board.makeMove(rm.move);
+        int wdl = -probeWDL(board, result);
+        board.undoLastMove();
+
+        if (result == PROBE_FAIL){
+            return false;
+        }
+        rm.tbRank = WDL_TO_RANK[wdl + 2];
+        rm.tbScore = WDL_TO_SCORE[wdl + 2];
+    }
+    return true;
+}
+
+static void initIndexTables(){
+    // mapB1H1H7 encodes the squares below the a1-h8 diagonal to 0...27
+    int code = 0;
+
+    for (int sq = SQ_A1; sq <= SQ_H8; sq++){
+        if (offA1H8(sq) < 0){
+            mapB1H1H7[sq] = code++;
+        }
+    }
+
+    // mapA1D1D4 encodes the a1-d1-d4 triangle to 0...9 (diagonal squares last)
+    std::vector<int> diagonal;
+    code = 0;
+
+    for (int sq = SQ_A1; sq <= SQ_D4; sq++){
+        if (offA1H8(sq) < 0 and getFile(sq) <= FILE_D){
+            mapA1D1D4[sq] = code++;
+        }
+        else if (!offA1H8(sq) and getFile(sq) <= FILE_D){
+            diagonal.push_back(sq);
+        }
+    }
+    for (int sq : diagonal){
+        mapA1D1D4[sq] = code++;
+    }
+
+    // mapKK encodes the 462 legal placements of 2 kings with the first king in the a1-d1-d4
+    // triangle (if the first king is on the diagonal, the second can't be above it)
+    std::vector<std::pair<int, int>> bothOnDiagonal;
+    code = 0;
+
+    for (int idx = 0; idx < 10; idx++){
+        for (int sq1 = SQ_A1; sq1 <= SQ_D4; sq1++){
+            if (mapA1D1D4[sq1] != idx or (!idx and sq1 != SQ_B1)){
+                continue;
+            }
+            for (int sq2 = SQ_A1; sq2 <= SQ_H8; sq2++){
+                if ((kingAttack(sq1) | (1ULL << sq1)) & (1ULL << sq2)){
+                    continue;
+                }
+                else if (!offA1H8(sq1) and offA1H8(sq2) > 0){
+                    continue;
+                }
+                else if (!offA1H8(sq1) and !offA1H8(sq2)){
+                    bothOnDiagonal.emplace_back(idx, sq2);
+                }
+                else{
+                    mapKK[idx][sq2] = code++;
+                }
+            }
+        }
+    }
+    for (auto [idx, sq] : bothOnDiagonal){
+        mapKK[idx][sq] = code++;
+    }
+
+    // binomial[k][n] is the number of ways to choose k elements from n elements
+    binomial[0][0] = 1;
+
+    for (int n = 1; n < 64; n++){
+        for (int k = 0; k < 6 and k <= n; k++){
+            binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+        }
+    }
+
+    // mapPawns encodes a2...h7 to 0...47 so that the leading pawn (highest value) is the one
+    // closest to the edge and with the lowest rank. leadPawnIdx and leadPawnsSize are the
+    // indices of the leading pawn groups for each file
+    int availableSquares = 47;
+
+    for (int leadPawnsCnt = 1; leadPawnsCnt <= 5; leadPawnsCnt++){
+        for (int f = FILE_A; f <= FILE_D; f++){
+            int idx = 0;
+
+            for (int r = RANK2; r <= RANK_7; r++){
+                int sq = posToSquare(r, f);
+
+                if (leadPawnsCnt == 1){
+                    mapPawns[sq] = availableSquares--;
+                    mapPawns[sq ^ 7] = availableSquares--;
+                }
+                leadPawnIdx[leadPawnsCnt][sq] = idx;
+                idx += binomial[leadPawnsCnt - 1][mapPawns[sq]];
+            }
+            leadPawnsSize[leadPawnsCnt][f] = idx;
+        }
+    }
+}
+
+static void addTable(std::vector<Piece> pieces){
+    // Add the table for these pieces (ex: {KING, ROOK, KING} is KRvK) if its WDL file exists
+    std::string code;
+
+    for (Piece pieceType : pieces){
+        code += TB_PIECE_CHARS[pieceType];
+    }
+    code.insert(code.find('K', 1), "v");
+
+    if (findFile(code + ".rtbw").empty()){
+        return;
+    }
+    tbLargest = std::max(tbLargest, static_cast<int>(pieces.size()));
+
+    // Count the pieces of each side (the first side is white)
+    int counts[2][7] = {};
+    Color side = WHITE;
+
+    for (char c : code){
+        if (c == 'v'){
+            side = BLACK;
+        }
+        else{
+            counts[side][TB_PIECE_CHARS.find(c)]++;
+        }
+    }
+
+    wdlTables.emplace_back();
+    TBTable<TB_WDL> &wdl = wdlTables.back();
+
+    wdl.key = materialKey(counts);
+    std::swap(counts[WHITE], counts[BLACK]);
+    wdl.key2 = materialKey(counts);
+    std::swap(counts[WHITE], counts[BLACK]);
+
+    wdl.pieceCount = pieces.size();
+    wdl.hasPawns = counts[WHITE][PAWN] or counts[BLACK][PAWN];
+
+    for (Color col : {WHITE, BLACK}){
+        for (Piece pieceType = PAWN; pieceType < KING; pieceType++){
+            wdl.hasUniquePieces |= (counts[col][pieceType] == 1);
+        }
+    }
+
+    // The leading color is the side with less pawns (but more than 0) since it compresses better
+    bool lead = !counts[BLACK][PAWN] or (counts[WHITE][PAWN] and counts[BLACK][PAWN] >= counts[WHITE][PAWN]);
+    wdl.pawnCount[0] = counts[lead ? WHITE : BLACK][PAWN];
+    wdl.pawnCount[1] = counts[lead ? BLACK : WHITE][PAWN];
+
+    dtzTables.emplace_back();
+    TBTable<TB_DTZ> &dtz = dtzTables.back();
+
+    dtz.key = wdl.key;
+    dtz.key2 = wdl.key2;
+    dtz.pieceCount = wdl.pieceCount;
+    dtz.hasPawns = wdl.hasPawns;
+    dtz.hasUniquePieces = wdl.hasUniquePieces;
+    dtz.pawnCount[0] = wdl.pawnCount[0];
+    dtz.pawnCount[1] = wdl.pawnCount[1];
+
+    tbHash[wdl.key] = {&wdl, &dtz};
+    tbHash[wdl.key2] = {&wdl, &dtz};
+}
+
+void initTablebases(std::string paths){
+    tbHash.clear();
+    wdlTables.clear();
+    dtzTables.clear();
+    tbLargest = 0;
+    tbPaths = paths;
+
+    if (paths.empty() or paths == "<empty>"){
+        return;
+    }
+    initIndexTables();
+
+    // Try every material combination up to 7 pieces (the stronger side first)
+    for (Piece p1 = PAWN; p1 < KING; p1++){
+        addTable({KING, p1, KING});
+
+        for (Piece p2 = PAWN; p2 <= p1; p2++){
+            addTable({KING, p1, p2, KING});
+            addTable({KING, p1, KING, p2});
+
+            for (Piece p3 = PAWN; p3 < KING; p3++){
+                addTable({KING, p1, p2, KING, p3});
+            }
+            for (Piece p3 = PAWN; p3 <= p2; p3++){
+                addTable({KING, p1, p2, p3, KING});
+
+                for (Piece p4 = PAWN; p4 <= p3; p4++){
+                    addTable({KING, p1, p2, p3, p4, KING});
+
+                    for (Piece p5 = PAWN; p5 <= p4; p5++){
+                        addTable({KING, p1, p2, p3, p4, p5, KING});
+                    }
+                    for (Piece p5 = PAWN; p5 < KING; p5++){
+                        addTable({KING, p1, p2, p3, p4, KING, p5});
+                    }
+                }
+                for (Piece p4 = PAWN; p4 < KING; p4++){
+                    addTable({KING, p1, p2, p3, KING, p4});
+
+                    for (Piece p5 = PAWN; p5 <= p4; p5++){
+                        addTable({KING, p1, p2, p3, KING, p4, p5});
+                    }
+                }
+            }
+            for (Piece p3 = PAWN; p3 <= p1; p3++){
+                for (Piece p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); p4++){
+                    addTable({KING, p1, p2, KING, p3, p4});
+                }
+            }
+        }
+    }
+    std::cout << "info string Found " << wdlTables.size() << " tablebases" << std::endl;
+}
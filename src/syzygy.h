@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "board.h"
+#include "search.h"
+
+// Syzygy endgame tablebases (the probing code follows the format of the original Syzygy probing
+// code by Ronald de Man). Tablebase files are memory mapped the first time they are probed
+
+// Results of a WDL probe from the side to move's perspective. Cursed wins and blessed losses
+// are wins and losses that are draws due to the fifty move rule
+const int WDL_LOSS = -2;
+const int WDL_BLESSED_LOSS = -1;
+const int WDL_DRAW = 0;
+const int WDL_CURSED_WIN = 1;
+const int WDL_WIN = 2;
+
+// Outcome of a probe
+enum ProbeState{
+    PROBE_FAIL = 0,              // Probe failed (missing file or table)
+    PROBE_OK = 1,                // Probe succesful
+    PROBE_CHANGE_STM = -1,       // DTZ table should be probed with the other side to move
+    PROBE_ZEROING_BEST_MOVE = 2  // The best move is a zeroing move (capture or pawn move)
+};
+
+// Largest number of pieces among the tablebases we found (0 means no tablebases)
+extern int tbLargest;
+
+// Init (call again whenever the path changes). Directories are seperated by ':' (';' on Windows)
+void initTablebases(std::string paths);
+
+// Probing (the position is restored after every probe)
+int probeWDL(Position &board, ProbeState &result);
+int probeDTZ(Position &board, ProbeState &result);
+
+// Rank the root moves by DTZ (or WDL if DTZ is missing). Returns false if a probe failed
+bool probeRootDTZ(Position &board, std::vector<RootMove> &rootMoves);
+bool probeRootWDL(Position &board, std::vector<RootMove> &rootMoves);
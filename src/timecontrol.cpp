@@ -1,3 +1,4 @@
+#include <iostream>
 #include <chrono>
 #include <algorithm>
 #include <math.h>
@@ -6,38 +7,125 @@
 #include "timecontrol.h"
 #include "uci.h"
 
-const static TimePoint MOVE_LAG = 30;
+MoveOverheadTracker overheadTracker;
+
+void MoveOverheadTracker::clearPending(){
+    active = moves[WHITE].pending = moves[BLACK].pending = false;
+}
+
+void MoveOverheadTracker::startMove(Color col, const uciSearchLims &uci, bool isPonder, TimePoint goReceived){
+    OverheadMove &prev = moves[col];
+
+    // Take a sample from our previous move. Ponder searches are skipped since the GUI only
+    // starts our clock on ponderhit
+    if (prev.pending and !prev.ponder){
+        TimePoint overhead = -1;
+
+        // The clock can only be used if it hasn't been reset by movestogo
+        if (prev.clock and uci.timeLeft[col] and prev.movesToGo != 1){
+            TimePoint charged = prev.clock + prev.incr - uci.timeLeft[col] * 1000;
+            overhead = charged - prev.searchTime;
+        }
+        // Otherwise fall back on the time from receiving go to flushing bestmove
+        else if (!prev.clock){
+            overhead = prev.flushTime - prev.goTime - prev.searchTime;
+        }
+
+        // A negative sample means that the clock isn't from the same game
+        if (overhead >= 0){
+            if (samples == 0){
+                mean = overhead;
+                deviation = 0;
+            }
+            else{
+                deviation += OVERHEAD_EMA_ALPHA * (std::abs(overhead - mean) - deviation);
+                mean += OVERHEAD_EMA_ALPHA * (overhead - mean);
+            }
+            samples++;
+
+            std::cout << "info string move overhead " << overhead / 1000.0 << " ms (average " << mean / 1000.0 
+                      << " ms, reserve " << reserve() / 1000.0 << " ms)" << std::endl;
+        }
+    }
+
+    // Remember this move so that we can take a sample at the next go for this side
+    active = true;
+    activeSide = col;
+    prev.pending = false;
+    prev.ponder = isPonder;
+    prev.clock = uci.timeLeft[col] * 1000;
+    prev.incr = uci.timeIncr[col] * 1000;
+    prev.movesToGo = uci.movesToGo;
+    prev.goTime = goReceived;
+}
+
+void MoveOverheadTracker::endMove(TimePoint timeSearched, TimePoint bestMoveFlushed){
+    // Only searches started from go are tracked (not bench)
+    if (!active){
+        return;
+    }
+    active = false;
+    moves[activeSide].pending = true;
+    moves[activeSide].searchTime = timeSearched;
+    moves[activeSide].flushTime = bestMoveFlushed;
+}
+
+TimePoint MoveOverheadTracker::reserve(){
+    TimePoint minimum = static_cast<TimePoint>(moveOverhead) * 1000;
+
+    if (samples == 0){
+        return minimum;
+    }
+    return std::max(minimum, static_cast<TimePoint>(mean + OVERHEAD_DEV_MULT * deviation));
+}
 
 void timeMan::init(Color col, uciSearchLims uci){
-    forceStop = false;
     lastBestMove = NULL_OR_NO_MOVE;
     lastScore = NO_SCORE;
     stability = 0;
-    startTime = getTime();
+    depthSearched = 0;
+    stabilityScale = scoreChangeScale = 1.0;
+    startTime = clockStartTime = getTime();
+    ponderTime = 0;
 
     // If no time is given assume infinite
     infinite = uci.infinite or (!uci.timeLeft[col] and !uci.moveTime);
-    fixedMoveTime = uci.moveTime;
+    fixedMoveTime = uci.moveTime * 1000;
 
     if (infinite or fixedMoveTime)
         return;
+
+    TimePoint timeLeft = uci.timeLeft[col] * 1000;
+    TimePoint timeIncr = uci.timeIncr[col] * 1000;
     
     // X base time, Y increment, Z moves till reset (Z is 50 if there is no time reset)
 
     int mtg = (uci.movesToGo == 0) ? 50 : uci.movesToGo;
 
-    TimePoint totalTime = uci.timeLeft[col] + (uci.timeIncr[col] * mtg) - MOVE_LAG * mtg;
+    TimePoint moveLag = overheadTracker.reserve();
+    TimePoint totalTime = timeLeft + (timeIncr * mtg) - moveLag * mtg;
     
-    optimalTime = averageTime = std::clamp(static_cast<double>(totalTime) / mtg, (0.95 * uci.timeLeft[col]) / mtg, 0.8 * uci.timeLeft[col]);
+    optimalTime = averageTime = std::clamp(static_cast<double>(totalTime) / mtg, (0.95 * timeLeft) / mtg, 0.8 * timeLeft);
     
-    maximumTime = std::min(5.5 * averageTime, 0.8 * uci.timeLeft[col]);
+    // The hard limit also keeps a move's worth of lag in reserve so that we don't flag on a long move
+    maximumTime = std::min(5.5 * averageTime, 0.8 * timeLeft - moveLag);
+    maximumTime = std::max(maximumTime, optimalTime);
 }
 
-void timeMan::update(Depth depthSearched, Move bestMove, Score score, double percentTimeSpentOnNonBest){
+void timeMan::ponderhit(){
+    // Rebase the budget to the moment our clock started. Everything we searched so far was on the
+    // position that is now on the board so it all counts as time spent on the move
+    clockStartTime = getTime();
+    ponderTime = clockStartTime - startTime;
+}
+
+void timeMan::update(Depth depth, Move bestMove, Score score){
     // Don't do anything if we infinitely searching or searching for a fixed time
     if (infinite or fixedMoveTime)
         return;
 
+    depthSearched = depth;
+
     // Update stability
 
     stability = (bestMove != lastBestMove) ? 1 : std::min(stability + 1, 10);
@@ -45,38 +133,34 @@ void timeMan::update(Depth depthSearched, Move bestMove, Score score, double per
     // Linearly scale time based on how unstable the best move is
     // Stability range is [1, 10] and scale multiplier range is [0.75, 1.20]
 
-    double stabilityScale = 1.2 - 0.05 * stability;
+    double newStabilityScale = 1.2 - 0.05 * stability;
 
     // Linearly scale based on score fluctuation. Note that we should be more inclined
     // to increase time if our score suddenly decreases so we handle the score
     // increase and decrease cases seperately
 
     double absdiff = abs(score - lastScore);
-    double scoreChangeScale = 1;
+    double newScoreChangeScale = 1;
 
     // Score increase
     if (score >= lastScore){
-        scoreChangeScale = 0.75 + 0.5 * std::min(absdiff, 30.0) / 30.0;
+        newScoreChangeScale = 0.75 + 0.5 * std::min(absdiff, 30.0) / 30.0;
     }
     // Score decrease
     else{
-        scoreChangeScale = 0.75 + 0.5 * std::min(absdiff, 15.0) / 15.0;
+        newScoreChangeScale = 0.75 + 0.5 * std::min(absdiff, 15.0) / 15.0;
     }
-    
-    // Linearly scale time based on time spent on non-best move nodes 
-    // Note that the larger the value is the more complex our position is so the higher our scale should be
-    // Range is [0.7, 1.7] and 30% time is average which maps to 1.0
-
-    double complexityScale = 0.70 + percentTimeSpentOnNonBest;
 
     // Update info    
 
     lastBestMove = bestMove;
     lastScore = score;
 
-    // First few depths are unstable
+    // First few depths are unstable (the node fraction scale is applied in softLimit since it changes
+    // continuously during an iteration)
 
-    if (depthSearched >= 10){
-        optimalTime = averageTime * stabilityScale * scoreChangeScale * complexityScale;
+    if (depth >= TM_SCALE_MIN_DEPTH){
+        stabilityScale = newStabilityScale;
+        scoreChangeScale = newScoreChangeScale;
     }
 }
\ No newline at end of file
@@ -3,12 +3,67 @@
 #include "types.h"
 #include "helpers.h"
 #include "uci.h"
-#include "search.h"
 #include <chrono>
 
+// Soft time model. The soft limit is the average time per move scaled by best move stability, score change,
+// and the fraction of the root nodes that went to the best move (the more nodes the best move needs
+// compared to the others, the clearer it is that it's the best move so we can stop earlier)
+
+const Depth TM_SCALE_MIN_DEPTH = 10;         // Stability and score change scaling starts at this depth
+const Depth TM_NODE_MIN_DEPTH = 6;           // Node fraction scaling starts at this depth
+const double TM_NODE_BASE = 1.7;             // Node scale is TM_NODE_BASE - TM_NODE_SLOPE * best move node fraction
+const double TM_NODE_SLOPE = 1.0;
+const double TM_MID_ITERATION_SCALE = 1.5;   // During an iteration we only stop once we are this far past the soft limit
+
+// Tracks the time we lose per move outside of what the time manager measures (thread startup and
+// shutdown, printing, and the GUI / broker round trip). A sample is the time the GUI charged us for a
+// move (read off the clock it sends with the next go) minus the time the time manager measured for
+// that move. If the clock can't be used we fall back on the engine side time from go to bestmove.
+// The reserve is never smaller than the Move Overhead option
+
+const double OVERHEAD_EMA_ALPHA = 0.25;      // Weight of a new sample in the running mean and deviation
+const double OVERHEAD_DEV_MULT = 2.0;        // Reserve is mean + OVERHEAD_DEV_MULT * deviation
+
+// The last move searched for one side
+struct OverheadMove{
+    bool pending;
+    bool ponder;
+    TimePoint clock;
+    TimePoint incr;
+    int movesToGo;
+    TimePoint goTime;
+    TimePoint searchTime;
+    TimePoint flushTime;
+};
+
+struct MoveOverheadTracker{
+    // Moves are tracked per side since the clock we get with the next go of that side is what tells us
+    // how much we were charged
+    OverheadMove moves[2];
+    bool active;
+    Color activeSide;
+
+    // Running estimate
+    int samples;
+    double mean;
+    double deviation;
+
+    void clearPending();
+    void startMove(Color col, const uciSearchLims &uci, bool isPonder, TimePoint goReceived);
+    void endMove(TimePoint timeSearched, TimePoint bestMoveFlushed);
+    TimePoint reserve();
+};
+
+extern MoveOverheadTracker overheadTracker;
+
+// All times are in microseconds (UCI times are converted from milliseconds in init)
 struct timeMan{
-    bool forceStop;
     TimePoint startTime;
+
+    // Our clock only starts running on ponderhit. Ponder time counts towards the effective time
+    // spent on the move but the hard limit is on the time our clock ran
+    TimePoint clockStartTime;
+    TimePoint ponderTime;
     
     // Time variables
     TimePoint averageTime;
@@ -19,39 +74,51 @@ struct timeMan{
     Move lastBestMove; 
     Score lastScore;
     int stability;
+    Depth depthSearched;
+    double stabilityScale;
+    double scoreChangeScale;
 
     // Special UCI time specifications
     bool infinite;
     TimePoint fixedMoveTime;
 
     void init(Color col, uciSearchLims uci);
-    void update(Depth depthSearched, Move bestMove, Score score, double timeSpentOnNonBest);
+    void update(Depth depth, Move bestMove, Score score);
+    void ponderhit();
 
     inline TimePoint timeSpent(){
         return getTime() - startTime;
     }
-    inline bool stopAfterSearch(){
-        if (pondering){
-            return false;
-        }
-        else if (infinite){
+    inline TimePoint clockTimeSpent(){
+        return getTime() - clockStartTime;
+    }
+    inline TimePoint softLimit(double bestMoveNodeFraction){
+        double nodeScale = depthSearched >= TM_NODE_MIN_DEPTH ? TM_NODE_BASE - TM_NODE_SLOPE * bestMoveNodeFraction : 1.0;
+        return optimalTime * stabilityScale * scoreChangeScale * nodeScale;
+    }
+    // Never called while pondering (the search engine checks that first)
+    inline bool stopAfterSearch(double bestMoveNodeFraction){
+        if (infinite){
             return false;
         }
         else if (fixedMoveTime){
-            return timeSpent() >= fixedMoveTime;
+            return clockTimeSpent() >= fixedMoveTime;
         }
-        return forceStop or timeSpent() >= optimalTime;
+        return clockTimeSpent() + ponderTime >= softLimit(bestMoveNodeFraction);
     }
-    inline bool stopDuringSearch(){
-        if (pondering){
-            return false;
-        }
-        else if (infinite){
+    inline bool stopDuringSearch(double bestMoveNodeFraction){
+        if (infinite){
             return false;
         }
         else if (fixedMoveTime){
-            return timeSpent() >= fixedMoveTime;
+            return clockTimeSpent() >= fixedMoveTime;
         }
-        return forceStop or timeSpent() >= maximumTime;
+        // Hard limit or way past the soft limit once we have a completed iteration to fall back on
+        // (the node fraction keeps changing as the iteration goes on). If we pondered then the current
+        // iteration was mostly paid for by ponder time so we don't wait for it past the soft limit
+        TimePoint spent = clockTimeSpent();
+        double midIterationScale = ponderTime ? 1.0 : TM_MID_ITERATION_SCALE;
+
+        return spent >= maximumTime or (depthSearched and spent + ponderTime >= midIterationScale * softLimit(bestMoveNodeFraction));
     }
-};
\ No newline at end of file
+};
@@ -1,41 +1,128 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
 #include <cstring>
 #include <memory>
+#include <new>
+#include <array>
+#include <thread>
+#include <chrono>
 #include "types.h"
 #include "helpers.h"
 #include "tt.h"
 
-ttStruct globalTT;
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-TTKey ttRngPiece[7][2][64]; 
-TTKey ttRngTurn;
-TTKey ttRngEnpass[16];
-TTKey ttRngCastle[16];
+struct ZobristKeys{
+    std::array<std::array<std::array<TTKey, 64>, 2>, 7> piece;
+    TTKey turn;
+    std::array<TTKey, 16> enpass;
+    std::array<TTKey, 16> castle;
+};
 
-static uint64 seed = 1928777382391231823ULL;
+// Also written into saved hash files
+static const uint64 ZOBRIST_SEED = 1928777382391231823ULL;
 
-static inline uint64 genRand(){
-    return seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
-}
+static constexpr ZobristKeys genZobristKeys(){
+    ZobristKeys keys = {};
+    uint64 seed = ZOBRIST_SEED;
+
+    auto genRand = [&seed](){
+        return seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    };
 
-void initTT(){
     for (Piece pieceType : {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING}){
         for (Color col : {WHITE, BLACK}){
             for (Square sq = 0; sq < 64; sq++){
-                ttRngPiece[pieceType][col][sq] = genRand();
+                keys.piece[pieceType][col][sq] = genRand();
             }
         }
     }
 
-    ttRngTurn = genRand();
+    keys.turn = genRand();
     
     for (File enpassFile = 0; enpassFile <= 7; enpassFile++){
-        ttRngEnpass[enpassFile] = genRand();
+        keys.enpass[enpassFile] = genRand();
     }   
     for (int8 castle = 0; castle < 16; castle++){
-        ttRngCastle[castle] = genRand();
+        keys.castle[castle] = genRand();
+    }
+    return keys;
+}
+
+// Keys are generated by the compiler (same sequence as before so hashes don't change)
+static constexpr ZobristKeys ZOBRIST_KEYS = genZobristKeys();
+
+constexpr std::array<std::array<std::array<TTKey, 64>, 2>, 7> ttRngPiece = ZOBRIST_KEYS.piece;
+constexpr TTKey ttRngTurn = ZOBRIST_KEYS.turn;
+constexpr std::array<TTKey, 16> ttRngEnpass = ZOBRIST_KEYS.enpass;
+constexpr std::array<TTKey, 16> ttRngCastle = ZOBRIST_KEYS.castle;
+
+static constexpr bool attacksOnEmptyBoard(Piece pieceType, Square st, Square en){
+    int di = getRank(st) > getRank(en) ? getRank(st) - getRank(en) : getRank(en) - getRank(st);
+    int dj = getFile(st) > getFile(en) ? getFile(st) - getFile(en) : getFile(en) - getFile(st);
+
+    bool diagonal = (di == dj);
+    bool straight = (!di or !dj);
+
+    switch (pieceType){
+        case KNIGHT: return (di == 1 and dj == 2) or (di == 2 and dj == 1);
+        case BISHOP: return diagonal;
+        case ROOK:   return straight;
+        case QUEEN:  return diagonal or straight;
+        case KING:   return di <= 1 and dj <= 1;
+        default:     return false;
+    }
+}
+
+static constexpr CuckooTable genCuckooTable(){
+    CuckooTable table = {};
+
+    for (Piece pieceType : {KNIGHT, BISHOP, ROOK, QUEEN, KING}){
+        for (Color col : {WHITE, BLACK}){
+            for (Square st = 0; st < 64; st++){
+                for (Square en = st + 1; en < 64; en++){
+                    if (!attacksOnEmptyBoard(pieceType, st, en)){
+                        continue;
+                    }
+                    Move move = encodeMove(st, en, 0);
+                    TTKey key = ZOBRIST_KEYS.piece[pieceType][col][st] ^ ZOBRIST_KEYS.piece[pieceType][col][en] ^ ZOBRIST_KEYS.turn;
+                    int idx = cuckooHash1(key);
+
+                    // Insert and keep kicking out the occupant to its other slot until we hit an empty slot
+                    while (true){
+                        TTKey tempKey = table.keys[idx];
+                        Move tempMove = table.moves[idx];
+                        
+                        table.keys[idx] = key;
+                        table.moves[idx] = move;
+                        key = tempKey;
+                        move = tempMove;
+
+                        if (move == NULL_OR_NO_MOVE){
+                            break;
+                        }
+                        idx = (idx == cuckooHash1(key)) ? cuckooHash2(key) : cuckooHash1(key);
+                    }
+                    table.count++;
+                }
+            }
+        }
     }
+    return table;
 }
 
+constexpr CuckooTable cuckooTable = genCuckooTable();
+static_assert(cuckooTable.count == CUCKOO_MOVE_COUNT);
+
 void ttStruct::clearTT(){
     for (int i = 0; i < sz; i++){
         for (int j = 0; j < CLUSTER_SIZE; j++){
@@ -44,30 +131,175 @@ void ttStruct::clearTT(){
     }
 }
 
+ttStruct::~ttStruct(){
+    releaseTable();
+}
+
+void ttStruct::releaseTable(){
+    if (sharedBase){
+#ifdef _WIN32
+        UnmapViewOfFile(sharedBase);
+        CloseHandle(reinterpret_cast<HANDLE>(sharedMapping));
+#else
+        munmap(sharedBase, sharedMapping);
+#endif
+    }
+    sharedBase = nullptr;
+    sharedMapping = 0;
+    privateTable.reset();
+    table = nullptr;
+}
+
+void ttStruct::allocatePrivate(){
+    privateTable.reset(new ttCluster[sz]);
+    table = privateTable.get();
+}
+
+bool ttStruct::mapShared(uint64 bytes, bool &created){
+    // Map the segment (creating it with the given size if it doesn't exist yet) and set sz to its
+    // size in clusters. Returns false if we fail
+#ifdef _WIN32
+    HANDLE mmapHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, bytes >> 32, bytes & 0xFFFFFFFF, sharedName.c_str());
+
+    if (!mmapHandle){
+        return false;
+    }
+    created = GetLastError() != ERROR_ALREADY_EXISTS;
+    sharedBase = MapViewOfFile(mmapHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+
+    if (!sharedBase){
+        CloseHandle(mmapHandle);
+        return false;
+    }
+    sharedMapping = reinterpret_cast<uint64>(mmapHandle);
+
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(sharedBase, &info, sizeof(info));
+    bytes = info.RegionSize;
+#else
+    // POSIX names start with a slash
+    std::string name = sharedName[0] == '/' ? sharedName : "/" + sharedName;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    created = (fd != -1);
+
+    if (created){
+        if (ftruncate(fd, bytes) == -1){
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+    }
+    else{
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+
+        if (fd == -1){
+            return false;
+        }
+
+        // Wait for the creator to set the size (resizing a segment we didn't create would pull it out
+        // from under the processes that already mapped it)
+        struct stat statbuf;
+
+        for (int waited = 0; fstat(fd, &statbuf) == 0 and statbuf.st_size < static_cast<off_t>(sizeof(ttCluster)); waited++){
+            if (waited >= SHARED_HASH_ATTACH_TIMEOUT){
+                close(fd);
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        bytes = statbuf.st_size;
+    }
+    void *base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED){
+        if (created){
+            shm_unlink(name.c_str());
+        }
+        return false;
+    }
+    sharedBase = base;
+    sharedMapping = bytes;
+#endif
+
+    // Only use a power of 2 number of clusters
+    sz = 1;
+    while (2 * sz * sizeof(ttCluster) <= bytes)
+        sz *= 2;
+
+    table = static_cast<ttCluster*>(sharedBase);
+    return true;
+}
+
+bool ttStruct::removeShared(){
+    if (sharedName.empty()){
+        return false;
+    }
+#ifdef _WIN32
+    // Named mappings are removed by Windows once nobody has them open
+    return true;
+#else
+    std::string name = sharedName[0] == '/' ? sharedName : "/" + sharedName;
+    return shm_unlink(name.c_str()) == 0;
+#endif
+}
+
 void ttStruct::setSize(uint64 megabytes){
     sz = 1024;
     while (2 * sz * sizeof(ttCluster) <= (megabytes << 20))
         sz *= 2;
 
+    uint64 requested = sz * sizeof(ttCluster);
+
+    releaseTable();
+    currentAge = 0;
+
+    bool created = true;
+
+    if (!sharedName.empty() and !mapShared(requested, created)){
+        std::cout << "info string Could not map shared hash " << sharedName << " (using a private hash)" << std::endl;
+        releaseTable();
+
+        // The private table that we fall back to has to be cleared
+        created = true;
+    }
+    if (isShared()){
+        std::cout << "info string " << (created ? "Created" : "Attached to") << " shared hash " << sharedName
+                  << " (" << (sz * sizeof(ttCluster) >> 20) << " MB)" << std::endl;
+
+        // An existing segment keeps the size it was created with
+        if (sz * sizeof(ttCluster) != requested){
+            std::cout << "info string Hash size of " << (requested >> 20) << " MB ignored since shared hash "
+                      << sharedName << " already exists" << std::endl;
+        }
+    }
+    else{
+        allocatePrivate();
+    }
+
     // (% tt size) is equivilant to (& maskMod)
     maskMod = sz - 1;
 
-    table.reset(new ttCluster[sz]);
-
-    clearTT();
-    currentAge = 0;
+    // Don't wipe a segment that other processes are already using
+    if (created){
+        clearTT();
+    }
 }
 
 bool ttStruct::probe(TTKey probehash, ttEntry &tte, Depth ply){
     ttEntry *bucket = &table[(probehash & maskMod)].dat[0];
 
     for (int i = 0; i < CLUSTER_SIZE; i++){
-        if (bucket[i].zhash == probehash){
+        // Read the entry once since other threads may be writing to it
+        ttEntry entry = bucket[i];
+
+        if (entry.key() == probehash){
             // Update age of entry to be most recent
-            bucket[i].ageAndBound = encodeAgeAndBound(currentAge, decodeBound(bucket[i].ageAndBound));
+            bucket[i] = ttEntry(probehash, entry.score, entry.staticEval, entry.bestMove, entry.depth,
+                                encodeAgeAndBound(currentAge, decodeBound(entry.ageAndBound)));
             
             // Init and adjust score
-            tte = bucket[i];
+            tte = entry;
             tte.score = scoreFromTT(tte.score, ply);
 
             // Found entry
@@ -87,7 +319,7 @@ void ttStruct::addToTT(TTKey zhash, Score score, Score staticEval, Move bestMove
 
     for (int i = 0; i < CLUSTER_SIZE; i++){
         // An entry with this hash already exists
-        if (bucket[i].zhash == zhash){
+        if (bucket[i].key() == zhash){
             replace = i;
             break;
         }
@@ -104,13 +336,39 @@ void ttStruct::addToTT(TTKey zhash, Score score, Score staticEval, Move bestMove
     ttEntry newEntry = ttEntry(zhash, scoreToTT(score, ply), staticEval, bestMove, depth, encodeAgeAndBound(currentAge, bound));
 
     if (bound == BOUND_EXACT
-        or (bucket[replace].zhash != zhash and quality(newEntry, currentAge) + 1 + 2 * pvNode >= quality(bucket[replace], currentAge))
-        or (bucket[replace].zhash == zhash and depth + pvNode >= bucket[replace].depth))
+        or (bucket[replace].key() != zhash and quality(newEntry, currentAge) + 1 + 2 * pvNode >= quality(bucket[replace], currentAge))
+        or (bucket[replace].key() == zhash and depth + pvNode >= bucket[replace].depth))
     {
         bucket[replace] = newEntry;
     }
 }
 
+void ttStruct::addPersistent(TTKey zhash, Score score, Score staticEval, Move bestMove, Depth depth, Depth ply, TTboundAge bound){
+    ttEntry *bucket = &table[(zhash & maskMod)].dat[0];
+    int replace = 0;
+
+    // Same hash or the shallowest entry (empty slots have depth 0)
+    auto value = [](const ttEntry &entry){
+        return 2 * entry.depth + (decodeBound(entry.ageAndBound) == BOUND_EXACT);
+    };
+
+    for (int i = 0; i < CLUSTER_SIZE; i++){
+        if (bucket[i].key() == zhash){
+            replace = i;
+            break;
+        }
+        if (value(bucket[i]) < value(bucket[replace])){
+            replace = i;
+        }
+    }
+
+    ttEntry newEntry = ttEntry(zhash, scoreToTT(score, ply), staticEval, bestMove, depth, encodeAgeAndBound(currentAge, bound));
+
+    if (value(newEntry) >= value(bucket[replace])){
+        bucket[replace] = newEntry;
+    }
+}
+
 int ttStruct::hashFullness(){
     int counter = 0;
     for (int i = 0; i < 1000 / CLUSTER_SIZE; i++){
@@ -121,4 +379,155 @@ int ttStruct::hashFullness(){
         }
     }
     return counter;
-}
\ No newline at end of file
+}
+
+static bool isEmptyCluster(const ttCluster &cluster){
+    for (int j = 0; j < CLUSTER_SIZE; j++){
+        if (cluster.dat[j].zhash != NO_HASH){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ttStruct::save(const std::string &fileName, bool compress){
+    std::ofstream out(fileName, std::ios::binary);
+
+    if (!out){
+        return false;
+    }
+    ttFileHeader header = {};
+    std::memcpy(header.magic, TT_FILE_MAGIC, sizeof(header.magic));
+    header.zobristSeed = ZOBRIST_SEED;
+    header.clusters = sz;
+    header.age = currentAge;
+    header.compressed = compress;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Raw tables are one big write
+    if (!compress){
+        out.write(reinterpret_cast<const char*>(table), sz * sizeof(ttCluster));
+        return static_cast<bool>(out);
+    }
+
+    // Gather the clusters that aren't empty of every chunk so that each chunk is two writes
+    std::vector<uint8> bitmap(TT_FILE_CHUNK / 8);
+    std::vector<ttCluster> clusters;
+    clusters.reserve(TT_FILE_CHUNK);
+
+    for (int64_t start = 0; start < sz; start += TT_FILE_CHUNK){
+        int64_t end = std::min(sz, start + TT_FILE_CHUNK);
+        std::fill(bitmap.begin(), bitmap.end(), 0);
+        clusters.clear();
+
+        for (int64_t i = start; i < end; i++){
+            if (!isEmptyCluster(table[i])){
+                bitmap[(i - start) / 8] |= 1 << ((i - start) % 8);
+                clusters.push_back(table[i]);
+            }
+        }
+        out.write(reinterpret_cast<const char*>(bitmap.data()), bitmap.size());
+        out.write(reinterpret_cast<const char*>(clusters.data()), clusters.size() * sizeof(ttCluster));
+    }
+    return static_cast<bool>(out);
+}
+
+bool ttStruct::load(const std::string &fileName){
+    std::ifstream in(fileName, std::ios::binary);
+    ttFileHeader header;
+
+    if (!in or !in.read(reinterpret_cast<char*>(&header), sizeof(header))){
+        return false;
+    }
+    if (std::memcmp(header.magic, TT_FILE_MAGIC, sizeof(header.magic)) or header.zobristSeed != ZOBRIST_SEED
+        or !header.clusters or (header.clusters & (header.clusters - 1))
+        or header.clusters > (TT_MAX_MB << 20) / sizeof(ttCluster))
+    {
+        return false;
+    }
+
+    // The file has to be exactly as big as the table it claims to hold (for a compressed file we walk
+    // over the bitmaps) so that a broken file can't make us allocate a huge table
+    std::vector<uint8> bitmap(TT_FILE_CHUNK / 8);
+    std::vector<ttCluster> clusters(TT_FILE_CHUNK);
+
+    in.seekg(0, std::ios::end);
+    uint64 fileSize = in.tellg();
+    uint64 expectedSize = sizeof(header);
+
+    if (header.compressed){
+        for (uint64 start = 0; start < header.clusters and expectedSize <= fileSize; start += TT_FILE_CHUNK){
+            in.seekg(expectedSize);
+
+            if (!in.read(reinterpret_cast<char*>(bitmap.data()), bitmap.size())){
+                return false;
+            }
+            expectedSize += bitmap.size();
+
+            for (uint8 bits : bitmap){
+                expectedSize += countOnes(bits) * sizeof(ttCluster);
+            }
+        }
+    }
+    else{
+        expectedSize += header.clusters * sizeof(ttCluster);
+    }
+    if (fileSize != expectedSize){
+        return false;
+    }
+    in.seekg(sizeof(header));
+
+    // A shared table is mapped by others so it can't change size. The old table is only released once
+    // the new one has been allocated
+    if (static_cast<int64_t>(header.clusters) != sz){
+        if (isShared()){
+            return false;
+        }
+        ttCluster *newTable = new (std::nothrow) ttCluster[header.clusters];
+
+        if (!newTable){
+            return false;
+        }
+        releaseTable();
+        privateTable.reset(newTable);
+        table = newTable;
+        sz = header.clusters;
+        maskMod = sz - 1;
+    }
+    currentAge = header.age;
+
+    // From here on a truncated file leaves us with an empty table
+    if (!header.compressed){
+        if (!in.read(reinterpret_cast<char*>(table), sz * sizeof(ttCluster))){
+            clearTT();
+            return false;
+        }
+        return true;
+    }
+
+    for (int64_t start = 0; start < sz; start += TT_FILE_CHUNK){
+        int64_t end = std::min(sz, start + TT_FILE_CHUNK);
+        int count = 0;
+
+        if (!in.read(reinterpret_cast<char*>(bitmap.data()), bitmap.size())){
+            clearTT();
+            return false;
+        }
+        for (uint8 bits : bitmap){
+            count += countOnes(bits);
+        }
+        if (!in.read(reinterpret_cast<char*>(clusters.data()), count * sizeof(ttCluster))){
+            clearTT();
+            return false;
+        }
+
+        // Spread the clusters back out and clear the rest
+        int idx = 0;
+
+        for (int64_t i = start; i < end; i++){
+            table[i] = (bitmap[(i - start) / 8] >> ((i - start) % 8)) & 1 ? clusters[idx++] : ttCluster();
+        }
+    }
+    return true;
+}
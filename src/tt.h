@@ -1,9 +1,13 @@
 #pragma once
 
 #include <memory>
+#include <array>
+#include <string>
+#include <cstring>
 #include "types.h"
 #include "helpers.h"
 #include "assert.h"
+#include "movepick.h"
 
 // We store buckets of size 4.
 
@@ -14,6 +18,9 @@
 //     best move: 2
 //     depth: 1
 //     age and bound: 1 (bits [0...5] are age and [6...7] is bound)
+//
+// The hash is stored xored with the other 8 bytes. The table is shared by threads (and possibly by
+// processes) without locks so an entry torn by two writers at once no longer matches its key
 
 const int CLUSTER_SIZE = 4;
 
@@ -25,11 +32,33 @@ const TTboundAge AGE_CYCLE = 63;
 const TTboundAge AGE_BITS = 63;
 const TTboundAge BOUND_BITS = 192;
 
-// Hash values
-extern TTKey ttRngPiece[7][2][64]; 
-extern TTKey ttRngTurn;
-extern TTKey ttRngEnpass[16];
-extern TTKey ttRngCastle[16];
+// Hash values (generated at compile time in tt.cpp)
+extern const std::array<std::array<std::array<TTKey, 64>, 2>, 7> ttRngPiece;
+extern const TTKey ttRngTurn;
+extern const std::array<TTKey, 16> ttRngEnpass;
+extern const std::array<TTKey, 16> ttRngCastle;
+
+// Cuckoo table of reversible moves (a non-pawn piece moving between two squares that it attacks on an
+// empty board) keyed by the hash difference the move makes. Used for upcoming repetition detection.
+// There are 3668 such moves and each is stored at one of its two hash slots (generated at compile time in tt.cpp)
+const int CUCKOO_SIZE = 8192;
+const int CUCKOO_MOVE_COUNT = 3668;
+
+struct CuckooTable{
+    TTKey keys[CUCKOO_SIZE];
+    Move moves[CUCKOO_SIZE];
+    int count;
+};
+
+extern const CuckooTable cuckooTable;
+
+constexpr int cuckooHash1(TTKey key){
+    return key & (CUCKOO_SIZE - 1);
+}
+
+constexpr int cuckooHash2(TTKey key){
+    return (key >> 16) & (CUCKOO_SIZE - 1);
+}
 
 struct ttEntry{
     TTKey zhash;
@@ -55,37 +84,107 @@ struct ttEntry{
         bestMove(bestMove_),
         depth(depth_),
         ageAndBound(ageAndBound_)
-    {}
+    {
+        zhash ^= data();
+    }
+
+    // Everything but the hash as one word
+    inline uint64 data() const{
+        uint64 val;
+        std::memcpy(&val, reinterpret_cast<const char*>(this) + sizeof(TTKey), sizeof(val));
+        return val;
+    }
+    inline TTKey key() const{
+        return zhash ^ data();
+    }
 };
 
+static_assert(sizeof(ttEntry) == 16, "ttEntry must be 16 bytes");
+
 struct ttCluster{
     ttEntry dat[CLUSTER_SIZE];
 };
 
+// Persistent hash: a smaller second table that only keeps deep entries and never ages them out so that
+// expensive results survive being replaced in the TT during long analyses (and ucinewgame). It is only
+// probed after a TT miss at nodes with at least PERSISTENT_PROBE_DEPTH depth left
+const Depth PERSISTENT_MIN_DEPTH = 20;
+const Depth PERSISTENT_PROBE_DEPTH = 8;
+
+// Saved hash files start with this header and then have the clusters in chunks of TT_FILE_CHUNK clusters.
+// Compressed chunks are a bitmap of the clusters that aren't empty followed by only those clusters
+const char TT_FILE_MAGIC[8] = {'S', 'U', 'H', 'A', 'S', 'H', '0', '1'};
+const int TT_FILE_CHUNK = 65536;
+
+struct ttFileHeader{
+    char magic[8];
+    uint64 zobristSeed;     // Entries are useless if the hash keys changed
+    uint64 clusters;
+    uint8 age;
+    uint8 compressed;
+    uint8 padding[6];
+};
+
+// Largest hash size (MB) that can be set or loaded
+const uint64 TT_MAX_MB = 65536;
+
+// How long (ms) a process that attaches to a shared hash waits for the creator to set its size
+const int SHARED_HASH_ATTACH_TIMEOUT = 5000;
+
 struct ttStruct{
     int64_t sz;
     int64_t maskMod;
     TTboundAge currentAge;
-    std::unique_ptr<ttCluster[]> table;
+    ttCluster *table = nullptr;
+
+    // If set, setSize maps the named shared memory segment instead of allocating a private table so
+    // that engine processes on the same machine share one hash. The first process creates the segment
+    // and later ones use it at its size (waiting up to SHARED_HASH_ATTACH_TIMEOUT ms for the creator to
+    // size it). The segment lives until removeShared is called (/dev/shm on Linux, on Windows it goes
+    // away with the last process that uses it)
+    std::string sharedName;
+
+    ~ttStruct();
 
     void clearTT();
     void setSize(uint64_t megabytes);
 
+    inline bool isShared(){
+        return sharedBase != nullptr;
+    }
+
+    // Remove the name of the shared segment so that the next process creates a new one (processes that
+    // are using it keep their mapping). Returns false if there is no such segment
+    bool removeShared();
+
     bool probe(TTKey zhash, ttEntry &tte, Depth ply);
     void addToTT(TTKey zhash, Score score, Score staticEval, Move bestMove, Depth depth, Depth ply, TTboundAge bound, bool pvNode);
+
+    // Replacement for the persistent hash (deeper entries and exact bounds win and age is ignored)
+    void addPersistent(TTKey zhash, Score score, Score staticEval, Move bestMove, Depth depth, Depth ply, TTboundAge bound);
     
     int hashFullness();
 
+    // Write the table to a file and read it back (resizing a private table to the size in the file)
+    bool save(const std::string &fileName, bool compress);
+    bool load(const std::string &fileName);
+
     inline void incrementAge(){
         currentAge = ((currentAge + 1) & AGE_CYCLE);
     }
     inline void prefetch(TTKey zhash){
         __builtin_prefetch(&table[zhash & maskMod]);
     }
-};
 
-// Our global TT
-extern ttStruct globalTT;
+private:
+    std::unique_ptr<ttCluster[]> privateTable;
+    void *sharedBase = nullptr;
+    uint64 sharedMapping = 0;
+
+    bool mapShared(uint64 bytes, bool &created);
+    void allocatePrivate();
+    void releaseTable();
+};
 
 // Bits [0...5] are age and [6...7] is bound
 inline TTboundAge encodeAgeAndBound(TTboundAge age, TTboundAge bound){
@@ -105,16 +204,17 @@ inline TTboundAge decodeAge(TTboundAge val){
 // We want mate scores to be relative to the subtree searched.
 // For example if we are at a subtree with root at 5 and our score is (mateScore - 10) relative
 // to the entire search tree, then our score is (mateScore - 5) relative to the ply 5 node.
+// The same goes for tablebase win scores.
 
 inline Score scoreToTT(Score score, Depth rootPly){
-    if (abs(score) >= FOUND_MATE){
+    if (abs(score) >= FOUND_TB_WIN){
         return score > 0 ? score + rootPly : score - rootPly;
     }
     return score;
 }
 
 inline Score scoreFromTT(Score score, Depth rootPly){
-    if (abs(score) >= FOUND_MATE){
+    if (abs(score) >= FOUND_TB_WIN){
         return score > 0 ? score - rootPly : score + rootPly;
     }
     return score;
@@ -133,7 +233,4 @@ inline int quality(ttEntry entry, TTboundAge ttCurrentAge){
     }
     // Quality is age * 4 + depth
     return age * 4 + entry.depth;
-}
-
-// Generate TT keys
-void initTT();
\ No newline at end of file
+}
\ No newline at end of file
@@ -34,7 +34,7 @@ using Score = int16;
 using Movescore = int32;
 using NNUEWeight = int16;
 
-using TimePoint = int64;
+using TimePoint = int64; // Microseconds
 using Bitboard = uint64;
 using TTKey = uint64;
 
@@ -68,6 +68,11 @@ const TTKey NO_HASH = 0;
 const int MAX_MOVES_IN_TURN = 250;
 const Depth MAX_PLY = 100;
 
+// Tablebase win scores (a win found at some ply gets TB_WIN_SCORE - ply so any score at
+// least FOUND_TB_WIN is either a tablebase win or a mate)
+const Score TB_WIN_SCORE = FOUND_MATE - 1;
+const Score FOUND_TB_WIN = TB_WIN_SCORE - MAX_PLY;
+
 // No enpassant
 const File NO_EP = 15;
 
@@ -2,13 +2,29 @@
 #include <sstream>
 #include <string>
 #include <cstring>
+#include <cctype>
 #include <thread>
+#include <algorithm>
 #include "board.h"
 #include "tt.h"
 #include "uci.h"
 #include "search.h"
-
-int threadCount;
+#include "bench.h"
+#include "datagen.h"
+#include "packed.h"
+#include "evalbatch.h"
+#include "epd.h"
+#include "server.h"
+#include "syzygy.h"
+#include "book.h"
+#include "timecontrol.h"
+
+int syzygyProbeDepth = 1;
+int syzygyProbeLimit = 7;
+int moveOverhead = 10;
+bool ownBook = false;
+static int hashSize = 16;
+static bool sharedHashPending = false;
 static Position board;
 
 char pieceToChar(Piece p){
@@ -87,22 +103,18 @@ Move stringToMove(std::string move){
 
 void Position::resetStack(){
     pos[0] = pos[stk];
+    keyHistory[0] = keyHistory[stk];
     stk = 0;
 }
 
-void Position::readFen(std::string fen){
-    // Step 1) We break apart the fen by seperating into multiple strings.
-    std::istringstream iss(fen);
-    std::string piecePosStr, playerTurnStr, castleStr, enpassTargetStr, halfMoveClockStr, currentFullMoveStr;
-    iss >> piecePosStr >> playerTurnStr >> castleStr >> enpassTargetStr >> halfMoveClockStr >> currentFullMoveStr;
-
-    // Step 2) Reset everything that must be reset
+void Position::clearPosition(){
+    // Reset everything that must be reset before a new position is set up
     std::fill(board, board + 64, NO_PIECE);
     memset(pieceBB, 0, sizeof(pieceBB));
     memset(colorBB, 0, sizeof(colorBB));
     allBB = 0;
 
-    pos.resize(MAX_PLY + 105);
+    pos.resize(POSITION_STACK_SIZE);
     stk = 0;
     
     pos[stk].move = NULL_OR_NO_MOVE;
@@ -110,8 +122,33 @@ void Position::readFen(std::string fen){
     pos[stk].castleRights = 0;
     pos[stk].epFile = NO_EP;
     pos[stk].halfMoveClock = 0;
+    pos[stk].pliesFromNull = 0;
     pos[stk].moveCount = 0;
     pos[stk].zhash = 0;
+}
+
+void Position::finishSetup(){
+    // Once the pieces, turn, and state are set up we can compute everything that depends on them
+
+    // Step 1) Fold everything into zhash
+    pos[stk].zhash ^= ttRngCastle[pos[stk].castleRights] ^ ttRngEnpass[pos[stk].epFile] ^ (ttRngTurn * turn);
+    keyHistory[stk] = pos[stk].zhash;
+    
+    // Step 2) Refresh NNUE
+    pos[stk].nnue.refresh(board, kingSq(WHITE), kingSq(BLACK));
+
+    // Step 3) Checkers, pins, and check squares
+    calcCheckInfo();
+}
+
+void Position::readFen(std::string fen){
+    // Step 1) We break apart the fen by seperating into multiple strings.
+    std::istringstream iss(fen);
+    std::string piecePosStr, playerTurnStr, castleStr, enpassTargetStr, halfMoveClockStr, currentFullMoveStr;
+    iss >> piecePosStr >> playerTurnStr >> castleStr >> enpassTargetStr >> halfMoveClockStr >> currentFullMoveStr;
+
+    // Step 2) Reset everything that must be reset
+    clearPosition();
     
     // Step 3) Fill the board
     Square sq = 56;
@@ -157,11 +194,8 @@ void Position::readFen(std::string fen){
     pos[stk].halfMoveClock = stoi(halfMoveClockStr);
     pos[stk].moveCount = (stoi(currentFullMoveStr) - 1) * 2 + turn;
 
-    // Step 7) Fold everything into zhash
-    pos[stk].zhash ^= ttRngCastle[pos[stk].castleRights] ^ ttRngEnpass[pos[stk].epFile] ^ (ttRngTurn * turn);
-    
-    // Step 8) Refresh NNUE
-    pos[stk].nnue.refresh(board, kingSq(WHITE), kingSq(BLACK));
+    // Step 7) Hash, NNUE, and check info
+    finishSetup();
 }
 
 std::string Position::getFen(){
@@ -227,20 +261,131 @@ std::string Position::getFen(){
 static void printInfo(){
     std::cout << "id name Superultra 2.1" << std::endl;
     std::cout << "id author Alexander Liang" << std::endl;
-    std::cout << "option name Hash type spin default 16 min 1 max 65536" << std::endl;
+    std::cout << "option name Hash type spin default 16 min 1 max " << TT_MAX_MB << std::endl;
+    std::cout << "option name SharedHash type string default <empty>" << std::endl;
+    std::cout << "option name PersistentHash type spin default 0 min 0 max 4096" << std::endl;
     std::cout << "option name Threads type spin default 1 min 1 max 2048" << std::endl;
     std::cout << "option name Ponder type check default false" << std::endl;
+    std::cout << "option name MultiPV type spin default 1 min 1 max " << MAX_MOVES_IN_TURN << std::endl;
+    std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+    std::cout << "option name SyzygyProbeDepth type spin default 1 min 1 max " << int(MAX_PLY) << std::endl;
+    std::cout << "option name SyzygyProbeLimit type spin default 7 min 0 max 7" << std::endl;
+    std::cout << "option name OwnBook type check default false" << std::endl;
+    std::cout << "option name BookFile type string default <empty>" << std::endl;
+    std::cout << "option name Move Overhead type spin default 10 min 0 max 5000" << std::endl;
     std::cout << "uciok" << std::endl;
 }
 
-static uciSearchLims proccessGo(std::istringstream &iss){
+bool checkFen(const std::string &fen, std::string &error){
+    // Reject anything that readFen or the search can't handle (readFen trusts its input)
+    std::istringstream iss(fen);
+    std::string placement, turn, castle, enpass, halfMove, fullMove;
+    iss >> placement >> turn >> castle >> enpass >> halfMove >> fullMove;
+
+    // Step 1) Pieces (8 ranks of 8 squares with exactly one king per side and no pawns on the back ranks)
+    char squares[64] = {};
+    int rank = 7, file = 0;
+    int kings[2] = {};
+
+    for (char c : placement){
+        if (c == '/'){
+            if (file != 8 or rank == 0){
+                error = "bad piece placement";
+                return false;
+            }
+            rank--;
+            file = 0;
+        }
+        else if (c >= '1' and c <= '8'){
+            file += c - '0';
+        }
+        else if (charToPiece(c) != NO_PIECE and file < 8){
+            Piece piece = charToPiece(c);
+
+            if (getPieceType(piece) == PAWN and (rank == 0 or rank == 7)){
+                error = "pawn on the first or last rank";
+                return false;
+            }
+            kings[getPieceColor(piece)] += (getPieceType(piece) == KING);
+            squares[8 * rank + file++] = c;
+        }
+        else{
+            error = "bad piece placement";
+            return false;
+        }
+        if (file > 8){
+            error = "bad piece placement";
+            return false;
+        }
+    }
+    if (rank != 0 or file != 8){
+        error = "bad piece placement";
+        return false;
+    }
+    if (kings[WHITE] != 1 or kings[BLACK] != 1){
+        error = "every side needs exactly one king";
+        return false;
+    }
+
+    // Step 2) Turn
+    if (turn != "w" and turn != "b"){
+        error = "bad side to move";
+        return false;
+    }
+
+    // Step 3) Castling rights need the king and rook on their starting squares
+    if (castle != "-"){
+        const std::string rights = "KQkq";
+        const std::string needed[4] = {"K", "Q", "k", "q"};
+        const Square kingSquares[4] = {SQ_E1, SQ_E1, SQ_E8, SQ_E8};
+        const Square rookSquares[4] = {SQ_H1, SQ_A1, SQ_H8, SQ_A8};
+
+        if (castle.empty()){
+            error = "bad castling rights";
+            return false;
+        }
+        for (char c : castle){
+            size_t i = rights.find(c);
+
+            if (i == std::string::npos
+                or squares[kingSquares[i]] != (i < 2 ? 'K' : 'k')
+                or squares[rookSquares[i]] != (i < 2 ? 'R' : 'r'))
+            {
+                error = "bad castling rights";
+                return false;
+            }
+        }
+    }
+
+    // Step 4) The en passant square needs the pawn that just moved two squares past it
+    if (enpass != "-"){
+        if (enpass.size() != 2 or enpass[0] < 'a' or enpass[0] > 'h' or enpass[1] != (turn == "w" ? '6' : '3')){
+            error = "bad en passant square";
+            return false;
+        }
+        Square target = (enpass[0] - 'a') + 8 * (enpass[1] - '1');
+        Square pawn = target + (turn == "w" ? -8 : 8);
+
+        if (squares[target] or squares[pawn] != (turn == "w" ? 'p' : 'P')){
+            error = "bad en passant square";
+            return false;
+        }
+    }
+
+    // Step 5) Clocks (optional)
+    for (const std::string &clock : {halfMove, fullMove}){
+        if (!clock.empty() and (clock.size() > 6 or !std::all_of(clock.begin(), clock.end(), ::isdigit))){
+            error = "bad move clocks";
+            return false;
+        }
+    }
+    return true;
+}
+
+uciSearchLims parseGo(std::istringstream &iss){
     std::string token;
     uciSearchLims lims = {};
 
-    // End search just in case
-    endSearch();
-    pondering = false;
-
     while (iss >> token){
         // Keep searching until stop command
         if (token == "infinite"){
@@ -280,14 +425,29 @@ static uciSearchLims proccessGo(std::istringstream &iss){
         else if (token == "nodes"){
             iss >> lims.nodeLim;
         }
-        // Ponder (not supported)
+        // Ponder (search until ponderhit or stop)
         else if (token == "ponder"){
-            pondering = true;
+            lims.ponder = true;
+        }
+        // Restrict the search to these moves (the rest of the command is the move list)
+        else if (token == "searchmoves"){
+            while (iss >> token){
+                lims.searchMoves.push_back(stringToMove(token));
+            }
         }
     }
     return lims;
 }
 
+// GUIs send options in any order so a shared hash is only created or attached to at isready (or at the
+// first command that uses the hash) and the Hash option sent after SharedHash sets the size it is created with
+static void mapSharedHash(){
+    if (sharedHashPending){
+        sharedHashPending = false;
+        globalEngine.tt.setSize(hashSize);
+    }
+}
+
 static void setOption(std::istringstream &iss){
     // setoption name option [value ...]
     std::string token, optionName;
@@ -299,19 +459,90 @@ static void setOption(std::istringstream &iss){
     while ((iss >> token) and token != "value"){
         optionName += (optionName.empty() ? "" : " ") + token;
     }
-    // TT table size
+    // TT table size (a shared hash is only mapped once the options are set, see mapSharedHash)
     if (optionName == "Hash"){
         iss >> token;
-        globalTT.setSize(stoi(token));
+        hashSize = stoi(token);
+
+        if (globalEngine.tt.sharedName.empty()){
+            globalEngine.tt.setSize(hashSize);
+        }
+        else{
+            sharedHashPending = true;
+        }
+    }
+    // Size of the persistent hash of deep entries (0 turns it off). It is off by default since it isn't cleared
+    // by ucinewgame (it is meant for long analyses) and would carry results from one game to the next
+    if (optionName == "PersistentHash"){
+        iss >> token;
+        globalEngine.setPersistentSize(std::clamp(stoi(token), 0, 4096));
+    }
+    // Name of a shared memory segment to use as the hash (empty for a private hash). Clearing the name
+    // also removes the segment we were using. The segment is mapped later (see mapSharedHash)
+    if (optionName == "SharedHash"){
+        std::string name;
+        std::getline(iss >> std::ws, name);
+        name = (name == "<empty>") ? "" : name;
+
+        if (name.empty() and globalEngine.tt.isShared() and globalEngine.tt.removeShared()){
+            std::cout << "info string Removed shared hash " << globalEngine.tt.sharedName << std::endl;
+        }
+        globalEngine.tt.sharedName = name;
+        sharedHashPending = !name.empty();
+
+        if (name.empty()){
+            globalEngine.tt.setSize(hashSize);
+        }
     }
     // Thread couunt
     if (optionName == "Threads"){
         iss >> token;
-        setThreadCount(stoi(token));
+        globalEngine.setThreadCount(stoi(token));
+    }
+    // Number of lines to search
+    if (optionName == "MultiPV"){
+        iss >> token;
+        globalEngine.multiPV = std::clamp(stoi(token), 1, MAX_MOVES_IN_TURN);
+    }
+    // Tablebase directories (the path may contain spaces)
+    if (optionName == "SyzygyPath"){
+        std::string path;
+        std::getline(iss >> std::ws, path);
+        initTablebases(path);
+    }
+    // Minimum depth to probe the tablebases at
+    if (optionName == "SyzygyProbeDepth"){
+        iss >> token;
+        syzygyProbeDepth = std::clamp(stoi(token), 1, static_cast<int>(MAX_PLY));
+    }
+    // Maximum number of pieces to probe the tablebases with
+    if (optionName == "SyzygyProbeLimit"){
+        iss >> token;
+        syzygyProbeLimit = std::clamp(stoi(token), 0, 7);
+    }
+    // Play moves from the opening book
+    if (optionName == "OwnBook"){
+        iss >> token;
+        ownBook = (token == "true");
+    }
+    // Polyglot opening book (the path may contain spaces)
+    if (optionName == "BookFile"){
+        std::string path;
+        std::getline(iss >> std::ws, path);
+        path = (path == "<empty>") ? "" : path;
+
+        if (!openBook(path)){
+            std::cout << "info string Could not open book " << path << std::endl;
+        }
+    }
+    // Minimum time reserved per move for communication lag
+    if (optionName == "Move Overhead"){
+        iss >> token;
+        moveOverhead = std::clamp(stoi(token), 0, 5000);
     }
 }
 
-static void setPos(std::istringstream &iss){
+void setPosition(Position &board, std::istringstream &iss){
     // Command: position [fen | startpos] moves ...
     std::string token;
     iss >> token;
@@ -345,9 +576,58 @@ static void setPos(std::istringstream &iss){
     }
 }
 
+void runBenchCommand(std::istringstream &iss){
+    std::string token;
+    bool smp = false;
+    int depth = 0;
+
+    while (iss >> token){
+        if (token == "perft"){
+            runPerftBench();
+            return;
+        }
+        else if (token == "timeman"){
+            runTimemanBench();
+            return;
+        }
+        else if (token == "startup"){
+            std::cout << "startup " << startupTime << " us" << std::endl;
+            return;
+        }
+        else if (token == "smp"){
+            smp = true;
+        }
+        else if (token.size() <= 2 and std::all_of(token.begin(), token.end(), ::isdigit)){
+            depth = std::clamp(stoi(token), 1, MAX_PLY - 1);
+        }
+        else{
+            std::cout << "usage: bench [depth] | bench smp [depth] | bench perft | bench timeman | bench startup" << std::endl;
+            return;
+        }
+    }
+    if (smp){
+        runSMPBench(depth ? depth : SMP_BENCH_DEPTH);
+    }
+    else{
+        runBench(depth ? depth : BENCH_DEPTH);
+    }
+}
+
 void doLoop(){
     std::thread searcherThread;
 
+    // Commands that use the engine (or take over the input) first end a running search (even an infinite
+    // one). The stop flag is cleared again since only go clears it before a search
+    auto stopSearch = [&](){
+        globalEngine.stop();
+        globalEngine.pondering = false;
+
+        if (searcherThread.joinable()){
+            searcherThread.join();
+        }
+        globalEngine.stopFlag = false;
+    };
+
     while (1){
         std::string cmd, token; 
         getline(std::cin, cmd);
@@ -362,16 +642,22 @@ void doLoop(){
         // Start a new game (we should also clear TT and history)
         else if (token == "ucinewgame"){
             board.readFen(startPosFen);
-            globalTT.clearTT(); 
-            clearAllSearchDataHistory();
+            globalEngine.clearHistory();
+
+            // A shared hash is also used by other processes
+            if (!globalEngine.tt.isShared()){
+                globalEngine.tt.clearTT(); 
+            }
+            overheadTracker.clearPending();
         }
         // Say that you are ready
         else if (token == "isready"){
+            mapSharedHash();
             std::cout << "readyok" << std::endl;
         }
         // Sets the position through base fen and sequence of moves
         else if (token == "position"){
-            setPos(iss);
+            setPosition(board, iss);
         }
         // Sets a single option
         else if (token == "setoption"){
@@ -379,41 +665,124 @@ void doLoop(){
         }
         // Search the position
         else if (token == "go"){
+            TimePoint goReceived = getTime();
+
             if (searcherThread.joinable()){
                 searcherThread.join();
             }
-            searcherThread = std::thread(beginSearch, board, proccessGo(iss));
+            mapSharedHash();
+            uciSearchLims lims = parseGo(iss);
+
+            // Book moves are played instantly (unless we have to wait for stop or only search some moves)
+            Move bookMove = (ownBook and !lims.infinite and !lims.ponder and lims.searchMoves.empty()) ? probeBook(board) : NULL_OR_NO_MOVE;
+
+            if (bookMove != NULL_OR_NO_MOVE){
+                std::cout << "bestmove " << moveToString(bookMove) << std::endl;
+
+                // The clock at the next go no longer belongs to the last searched move
+                overheadTracker.clearPending();
+                continue;
+            }
+            globalEngine.stopFlag = false;
+            globalEngine.pondering = lims.ponder;
+            overheadTracker.startMove(board.getTurn(), lims, lims.ponder, goReceived);
+
+            searcherThread = std::thread([position = board, lims](){
+                globalEngine.search(position, lims);
+                overheadTracker.endMove(globalEngine.timeSearched, getTime());
+            });
         }
         // The guessed move has been played so switch from ponder search to normal 
-        // search (don't reset tm). Also note that the blank gui screen is a result of
+        // search. The time budget is rebased so that the time we pondered counts towards
+        // the move (our clock only started now). Also note that the blank gui screen is a result of
         // ponderhit resetting the screen so if you pondered for long enough then the
         // moment you finish / end the search you will print out the best move and the
-        // screen will reset to pondering the next move
+        // screen will reset to pondering the next move. We don't join here so that we
+        // keep reading commands (such as stop) while the search goes on
 
         else if (token == "ponderhit"){
-            pondering = false;
-
-            if (searcherThread.joinable()){
-                searcherThread.join();
-            }
+            globalEngine.ponderHit();
         }
         // Stop the search
         else if (token == "stop"){
-            endSearch();
-            pondering = false;
+            stopSearch();
+        }
+        // Benchmark: "bench [depth]", "bench smp [depth]", "bench perft", "bench timeman", or "bench startup"
+        else if (token == "bench"){
+            stopSearch();
+            runBenchCommand(iss);
+        }
+        // Self-play training data: "datagen [games N] [threads N] [nodes N] [random N] [hash MB] [out file] [format text | packed]"
+        else if (token == "datagen"){
+            stopSearch();
+            runDatagenCommand(iss);
+        }
+        // Write the hash (or the persistent hash) to a file: "savehash [persistent] <file> [raw]"
+        // (empty clusters are left out unless raw)
+        else if (token == "savehash"){
+            stopSearch();
+            mapSharedHash();
+            std::string fileName, mode;
+            iss >> fileName;
+
+            bool persistent = (fileName == "persistent");
+            ttStruct &tt = persistent ? globalEngine.persistentTT : globalEngine.tt;
+
+            if (persistent){
+                iss >> fileName;
+            }
+            iss >> mode;
 
-            if (searcherThread.joinable()){
-                searcherThread.join();
+            TimePoint startTime = getTime();
+            bool saved = !fileName.empty() and (!persistent or globalEngine.persistentSize) and tt.save(fileName, mode != "raw");
+
+            std::cout << "info string " << (saved ? "Saved hash to " : "Could not save hash to ") << fileName
+                      << " in " << (getTime() - startTime) / 1000 << " ms" << std::endl;
+        }
+        // Read a hash written by savehash: "loadhash [persistent] <file>"
+        else if (token == "loadhash"){
+            stopSearch();
+            mapSharedHash();
+            std::string fileName;
+            iss >> fileName;
+
+            bool persistent = (fileName == "persistent");
+            ttStruct &tt = persistent ? globalEngine.persistentTT : globalEngine.tt;
+
+            if (persistent){
+                iss >> fileName;
             }
+
+            TimePoint startTime = getTime();
+            bool loaded = !fileName.empty() and (!persistent or globalEngine.persistentSize) and tt.load(fileName);
+
+            std::cout << "info string " << (loaded ? "Loaded hash from " : "Could not load hash from ") << fileName
+                      << " (" << (tt.sz * sizeof(ttCluster) >> 20) << " MB) in " 
+                      << (getTime() - startTime) / 1000 << " ms" << std::endl;
+        }
+        // Training data conversion: "convert [fen2packed | packed2fen] <infile> <outfile>"
+        else if (token == "convert"){
+            runConvertCommand(iss);
+        }
+        // Static NNUE eval of a FEN or EPD file: "evalbatch <infile> <outfile> [threads N]"
+        else if (token == "evalbatch"){
+            stopSearch();
+            runEvalBatchCommand(iss);
+        }
+        // Test suite: "epd <file> [movetime ms | nodes N | depth N] [jobs N] [hash MB]"
+        else if (token == "epd"){
+            stopSearch();
+            runEpdCommand(iss);
+        }
+        // Analysis server: "server [engines N] [threads N] [hash MB]" (reads the rest of the input)
+        else if (token == "server"){
+            stopSearch();
+            runServerCommand(iss);
+            break;
         }
         // End the program
         else if (token == "quit"){
-            endSearch();
-            pondering = false;
-
-            if (searcherThread.joinable()){
-                searcherThread.join();
-            }
+            stopSearch();
             break;
         }
     }
@@ -2,10 +2,20 @@
 
 #include <string>
 #include <vector>
+#include <sstream>
 #include "types.h"
 
-// Global number of threads
-extern int threadCount;
+class Position;
+
+// Global tablebase probing settings
+extern int syzygyProbeDepth;
+extern int syzygyProbeLimit;
+
+// Global opening book setting (play moves from the book opened with BookFile)
+extern bool ownBook;
+
+// Global minimum time in milliseconds reserved per move for communication lag (Move Overhead)
+extern int moveOverhead;
 
 // FEN of the default position
 const std::string startPosFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -20,6 +30,10 @@ struct uciSearchLims{
     TimePoint moveTime;
     uint64 nodeLim;
     bool infinite;
+    bool ponder;
+
+    // Only search these root moves (empty means search all moves)
+    std::vector<Move> searchMoves;
 };
 
 // UCI conversion functions and other utility functions
@@ -29,5 +43,13 @@ std::string squareToString(Square sq);
 std::string moveToString(Move move);
 Move stringToMove(std::string move);
 
+// Check that a FEN (clocks optional) is safe to give to readFen. On failure error says what is wrong
+bool checkFen(const std::string &fen, std::string &error);
+
+// Command parsing (also used by the analysis server): "position ..." and "go ..." arguments
+void setPosition(Position &board, std::istringstream &iss);
+uciSearchLims parseGo(std::istringstream &iss);
+
 // UCI driver
+void runBenchCommand(std::istringstream &iss);
 void doLoop();
\ No newline at end of file